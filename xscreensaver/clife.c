@@ -12,175 +12,130 @@
  * $kbyanc: life/xscreensaver/clife.c,v 1.18 2007/04/20 03:01:37 kbyanc Exp $
  */
 
-/* Undefine the following before testing any code changes! */
-#define NDEBUG
-
 #ifdef HAVE_CONFIG_H
 # include "config.h"
 #endif
 
-#include <assert.h>
-#include <dirent.h>
-#include <limits.h>
+#include <stdint.h>
 #include "screenhack.h"
+#include "clife_sim.h"
+#include <X11/keysym.h>
 
 #ifdef HAVE_DOUBLE_BUFFER_EXTENSION
 # include "xdbe.h"
 #endif /* HAVE_DOUBLE_BUFFER_EXTENSION */
 
+#ifdef HAVE_XSHM_EXTENSION
+# include "xshm.h"
+#endif /* HAVE_XSHM_EXTENSION */
+
 
 /*
  * Additional debugging aids:
  *	LIFE_SHOWGRID	   - Define to show cell cluster boundaries.
- *	LIFE_PRINTSTATS	   - Define to have cell/cluster stats printed.
- *	LIFE_PRINTPATTERNS - Define to print which patterns were loaded.
  */
 #undef LIFE_SHOWGRID
-#undef LIFE_PRINTSTATS
-#undef LIFE_PRINTPATTERNS
 
 
 /*
- * Data structures for representing Life patterns.
- * We will attempt to load any Life 1.05 format pattern files found in the
- * path specified via the -patterns command-line parameter or the patternPath
- * resource.  To keep things interesting for people who do not have a pattern
- * collection to pull from, we include 3 built-in patterns.  Please don't add
- * more.  If you want more patterns, store them in files and put the directory
- * to find those files in your patternPath.
- *
- * The number of cells for a single pattern is limited to a maximum of
- * PATTERN_MAXCOORDS cells.
+ * Frame pacing.  See life_hack_draw().
+ *	LIFE_MAXCATCHUP		- Most frames skipped at once to catch up.
  */
-#define	PATTERN_MAXCOORDS	256
-struct coords {
-	int x, y;
-};
-static struct coords builtin_pattern_coords[] = {
-#define	BUILTIN_PATTERN_GLIDER	(builtin_pattern_coords + 0)
-	{ 0, 0 }, { 1, 0 }, { 2, 0 },
-	{ 0, 1 },
-		  { 1, 2 },
-
-#define	BUILTIN_PATTERN_BHEPT	(builtin_pattern_coords + 5)
-		  { 1, 0 },
-	{ 0, 1 }, { 1, 1 }, { 2, 1 },
-	{ 0, 2 },	    { 2, 2 }, { 3, 2 },
-
-#define	BUILTIN_PATTERN_RABBITS	(builtin_pattern_coords + 12)
-	{ 0, 0 }, 				{ 4, 0 }, { 5, 0 }, { 6, 0 },
-	{ 0, 1 }, { 1, 1 }, { 2, 1 },			  { 5, 1 },
-		  { 1, 2 },
-
-	/* Offset 21: End-of-List */
-};
-
-struct pattern {
-	unsigned int width, height;
-	unsigned int numcoords;
-	struct coords *coords;
-};
-
-#define	NUMPATTERNS		16
-#define	NUMPATTERNSBUILTIN	3	/* Please don't add more. */
-static const struct pattern builtin_patterns[NUMPATTERNSBUILTIN] = {
-	{  3,  3,  5, BUILTIN_PATTERN_GLIDER },
-	{  4,  3,  7, BUILTIN_PATTERN_BHEPT },
-	{  7,  3,  9, BUILTIN_PATTERN_RABBITS }
-};
+#define	LIFE_MAXCATCHUP		4
 
 
 /*
- * The following limits apply to dormant clusters.
- *	LIMIT_DRAW	- Clusters dormant for more than this many iterations
- *			  will not be drawn.  Must be at least 1.
- *	LIMIT_UPDATE	- Clusters dormant for more than this many iterations
- *			  will not be updated; useful for skipping static
- *			  debris.  Must be at least 1 more than LIMIT_DRAW.
- *	LIMIT_KEEPEMPTY	- Clusters with no cells are kept for this many
- *			  cycles before deleting.  Should be greater than
- *			  LIMIT_UPDATE.
+ * The draw pass does not draw cells as it finds them, but sorts their
+ * rectangles into one bucket per color: the live colors, then the trail
+ * colors, then the background.  life_display_flush() then sends one
+ * XFillRectangles() request per non-empty bucket, rather than a request
+ * and a GC change per changed cell.
  */
-#define	LIMIT_DRAW	1
-#define	LIMIT_UPDATE	LIMIT_DRAW + 1
-#define	LIMIT_KEEPEMPTY	16
-
-
-typedef	unsigned char cell;
-#define	CELL_DEAD	0
-#define	CELL_MINALIVE	1
-#define	CELL_MAXCOLORS	85	/* Must be less than or equal to 1/3 of the
-				 * maximum value representable by cell's type.
-				 * See note in life_display_init().
-				 */
+struct life_fillbucket {
+	XRectangle	*rects;
+	int		 numrects;
+	int		 maxrects;
+};
 
 /*
- * The directions must be ordered such that direction (X) and direction
- * (NUMDIRECTIONS - X - 1) are opposites.  The following ordering is optimal
- * because it follows this rule and is ordered by increasing Y offset followed
- * by increasing X offset.
+ * With software double-buffering, only the parts of the back buffer which
+ * were drawn on are copied to the window.  Damage is recorded per cluster
+ * on the display and merged into at most LIFE_MAXDAMAGE rectangles by
+ * life_display_present().
  */
-#define NUMDIRECTIONS	8
-enum direction {
-	NORTHWEST = 0,
-	NORTH,
-	NORTHEAST,
-	WEST,
-	EAST,
-	SOUTHWEST,
-	SOUTH,
-	SOUTHEAST
-};
-
+#define	LIFE_MAXDAMAGE	128
 
 /*
- * Since the cell universe is often sparse, it is divided up into clusters
- * CLUSTERSIZE cells per side.  This allows regions known to be empty to
- * be skipped in the simulation loop.
- *
- * To prevent the frequent creation/deletion of nearly-empty clusters (i.e.
- * when a blinker crosses a cluster boundary), clusters are not immediately
- * freed when they become empty, but instead only after MAXDORMANTAGE
- * iterations empty.  Similarly, when a neighboring cluster has cells on the
- * adjacent edge, it will clear the dormant counter as an indication that the
- * cluster should not be deleted as it needs to check for spillover.
- *
- * The dormant counter is also used to avoid processing clusters which contain
- * static debris, as is common in life.
+ * Performance statistics, printed every statsInterval seconds if that
+ * resource is set; see life_stats_frame().  The simulation's counters are
+ * always kept, so all this costs when it is off is a few calls to
+ * life_time() per frame.  The time of each frame in an interval is kept
+ * so that percentiles can be reported.
  */
-#define	CLUSTERSIZE	8	/* Number of cells per cluster; power-of-2. */
-struct cell_cluster {
-	short			 numcells;
-	unsigned char		 dormant;	/* Iterations unchanged. */
-	unsigned char		 reserved;
-	int			 clusterX, clusterY;
-	struct cell_cluster	*neighbor[NUMDIRECTIONS];
-	cell			 oldcell[CLUSTERSIZE][CLUSTERSIZE];
-	cell			 cell[CLUSTERSIZE][CLUSTERSIZE];
-	unsigned char		 cellage[CLUSTERSIZE][CLUSTERSIZE];
+struct life_stats {
+	int64_t	 interval;	/* Microseconds between reports, or 0. */
+	int64_t	 start;		/* When this interval started. */
+	struct life_counters counters;	/* As of the start of the interval. */
+	unsigned int missed;	/* Likewise. */
+	unsigned int dropped;
+	int64_t	 updatetime;	/* Microseconds spent computing, */
+	int64_t	 drawtime;	/* drawing cells, */
+	int64_t	 presenttime;	/* and showing them. */
+	unsigned long requests;	/* X requests issued. */
+	int64_t	*frametimes;
+	int	 numframes;
+	int	 maxframes;
 };
 
 
+
 struct state {
 	/*
 	 * Display parameters.
 	 */
 	int	 delay;
 	int	 numcolors;
-	int	 colorwrap;
 	int	 double_buffer;
 	int	 DBEclear;	/* Use DBE to clear buffer. */
 
+	/* Frame pacing; see life_hack_draw(). */
+	int	 gensperframe;	/* Generations computed per frame. */
+	int64_t	 nextframe;	/* When the next frame is due, in usec. */
+	int	 maxcatchup;	/* Frames which may be skipped at once. */
+	unsigned int missed;	/* Frames finished after their deadline. */
+	unsigned int dropped;	/* Frames skipped to catch up. */
+
 	/* Internal display variables. */
 	XWindowAttributes xgwa;
 	XColor	*colors;
 	XColor	*trailcolors;
 	GC	 gc_erase;
 	GC	 gc_draw;
+	int	 cellsize;	/* Size of cells in pixels. */
+	int	 celldrawsize;	/* Actual number of pixels drawn per cell. */
 	int	 display_offsetX;
 	int	 display_offsetY;
+	int	 redraw;	/* Display must be drawn from scratch. */
 	Pixmap	 buf;		/* Current work buffer. */
 	Pixmap	 pixmap;	/* Backing pixmap, if any. */
+	struct life_fillbucket *buckets;	/* Cells waiting to be drawn. */
+	int	 numbuckets;
+	unsigned long bgpixel;
+	unsigned char *damage;	/* Clusters drawn on, if tracked. */
+	int	 damageall;	/* Whole window needs copying. */
+
+	/*
+	 * With the image renderer, cells are written straight into an XImage
+	 * instead and the part which changed is copied to the window.
+	 */
+	XImage	*ximage;
+	int	 imagedirect;	/* Pixels can be stored as uint32_t. */
+	int	 dirtyX1, dirtyY1;	/* Region changed since the last */
+	int	 dirtyX2, dirtyY2;	/* copy; empty if X1 >= X2. */
+#ifdef HAVE_XSHM_EXTENSION
+	int	 use_shm;
+	XShmSegmentInfo shm_info;
+#endif
 
 #ifdef HAVE_DOUBLE_BUFFER_EXTENSION
 	XdbeBackBuffer backbuf;
@@ -188,86 +143,143 @@ struct state {
 #endif
 
 	/*
-	 * Simulation state.
+	 * Simulation state; the display shows its view.  See clife_sim.h.
 	 */
-	struct cell_cluster **clustertable;
-
-	int	 numclusters;	/* Number of clusters allocated. */
-	int	 numcells;	/* Number of cells in those clusters. */
-	int	 maxclusters;
-	int	 maxcells;
-	int	 cluster_numX;
-	int	 cluster_numY;
-	int	 cell_numX;
-	int	 cell_numY;
-	int	 cellsize;	/* Size of cells in pixels. */
-	int	 celldrawsize;	/* Actual number of pixels drawn per cell. */
-	int	 cellmaxage;	/* Cells die when they reach this age. */
-	unsigned int iteration;
+	struct life_state life;
+	char	*snapshot;	/* Restored at startup and saved at exit. */
 
-	/*
-	 * Pattern data.
-	 */
-	struct pattern patterns[NUMPATTERNS];
+	struct life_stats stats;
 };
 
 
-static struct cell_cluster *life_cluster_new(struct state *st,
-					     int clusterX, int clusterY);
-static void	 life_cluster_delete(struct state *st,
-				     struct cell_cluster *cluster);
-static void	 life_cluster_update(struct state *st,
-				     struct cell_cluster *cluster);
-static void	 life_cluster_draw(const struct state * const st,
+static void	 life_cluster_draw(struct state *st,
 				   Display *dpy, Window window,
 				   const struct cell_cluster * const cluster,
-				   int xoffset, int yoffset);
-static void	 life_cluster_wakeneighbor(struct state *st,
-					   const struct cell_cluster *cluster,
-					   int xoffset, int yoffset);
-static void	 life_cell_set(struct state *st, int x, int y, int color);
-
-static void	 life_pattern_init(struct state *st, Display *dpy);
-static void	 life_pattern_free(struct state *st);
-static void	 life_pattern_draw(struct state *st);
-static int	 life_pattern_read(const struct state * const st,
-				   const char *filename,
-				   struct pattern *pattern);
-
-static void	 life_state_init(struct state *st, Display *dpy);
-static void	 life_state_free(struct state *st);
-static void	 life_state_update(struct state *st);
+				   int xoffset, int yoffset, int redraw);
+static void	 life_hashlife_draw(struct state *st, Display *dpy);
+
+static void	 life_state_setup(struct state *st, Display *dpy);
+static void	 life_display_cells(struct state *st, Display *dpy,
+				    int *cell_numX, int *cell_numY);
+static void	 life_display_layout(struct state *st);
 
 static void	 life_display_init(struct state *st, Display *dpy,
 				   Window window);
 static void	 life_display_free(struct state *st, Display *dpy);
 static void	 life_display_update(struct state *st,
 				     Display *dpy, Window window);
+static void	 life_display_redraw(struct state *st,
+				     Display *dpy, Window window);
+static void	 life_display_flush(struct state *st, Display *dpy);
+static void	 life_display_swap(struct state *st, Display *dpy,
+				   Window window);
+static void	 life_display_present(struct state *st, Display *dpy,
+				      Window window);
+static void	 life_image_init(struct state *st, Display *dpy, Window window);
+static void	 life_image_free(struct state *st, Display *dpy);
+static void	 life_display_pan(struct state *st, int xoffset, int yoffset);
 
 
 
+/*
+ * life_state_setup() - Set up the simulation according to the resources.
+ *
+ *	The simulation's view is as many whole clusters of cells as fit in
+ *	the window.
+ */
 void
-life_state_init(struct state *st, Display *dpy)
+life_state_setup(struct state *st, Display *dpy)
 {
+	struct life_params params;
+	char *pattern_path;
+
+	memset(&params, 0, sizeof(params));
+	params.progname = progname;
+	params.kernel = get_string_resource(dpy, "kernel", "Kernel");
+	params.engine = get_string_resource(dpy, "engine", "Engine");
+	params.maxage = get_integer_resource(dpy, "maxAge", "Integer");
+	params.scale = get_integer_resource(dpy, "universeScale", "Integer");
+	params.numthreads = get_integer_resource(dpy, "threads", "Integer");
+	params.hashstep = get_integer_resource(dpy, "hashStep", "Integer");
+	params.hashwarmup = get_integer_resource(dpy, "warmup", "Integer");
+	params.numcolors = st->numcolors;
+
+	/*
+	 * Only the last of several generations per frame is drawn, and frames
+	 * may be skipped altogether when we fall behind.
+	 */
+	st->gensperframe = get_integer_resource(dpy, "gensPerFrame",
+						"Integer");
+	if (st->gensperframe < 1)
+		st->gensperframe = 1;
+	else if (st->gensperframe > LIFE_MAXGENSPERFRAME)
+		st->gensperframe = LIFE_MAXGENSPERFRAME;
+	st->maxcatchup = 0;
+	if (get_boolean_resource(dpy, "dropFrames", "Boolean")) {
+		st->maxcatchup = LIFE_MAXGENSPERFRAME / st->gensperframe - 1;
+		if (st->maxcatchup > LIFE_MAXCATCHUP)
+			st->maxcatchup = LIFE_MAXCATCHUP;
+	}
+	params.gensperdraw = st->gensperframe * (1 + st->maxcatchup);
+	st->nextframe = 0;
+	st->missed = st->dropped = 0;
 
-	st->cellmaxage = get_integer_resource(dpy, "maxAge", "Integer");
-	if (st->cellmaxage < 1)
-		st->cellmaxage = 0;
-	else if (st->cellmaxage > UCHAR_MAX)
-		st->cellmaxage = UCHAR_MAX;
+	life_display_cells(st, dpy, &params.cell_numX, &params.cell_numY);
+	life_state_init(&st->life, &params);
+	free((char *)params.kernel);
+	free((char *)params.engine);
+
+	st->damage = NULL;
+	life_display_layout(st);
+	st->redraw = False;
+
+	/* Start on the builtin patterns rather than wait for the others. */
+	pattern_path = get_string_resource(dpy, "patternPath", "String");
+	life_pattern_init(&st->life, pattern_path, True);
+	free(pattern_path);
+
+	/*
+	 * Pick up where the last run left off, if it saved a snapshot.  There
+	 * is none the first time, which is not worth complaining about.
+	 */
+	st->snapshot = get_string_resource(dpy, "snapshotFile", "String");
+	if (st->snapshot != NULL && *st->snapshot == '\0') {
+		free(st->snapshot);
+		st->snapshot = NULL;
+	}
+	if (st->snapshot != NULL)
+		life_state_restore(&st->life, st->snapshot);
+
+	/* The counters all start at 0, as does the first interval. */
+	free(st->stats.frametimes);
+	memset(&st->stats, 0, sizeof(st->stats));
+	st->stats.interval = (int64_t)get_integer_resource(dpy,
+	    "statsInterval", "Integer") * 1000000;
+	if (st->stats.interval < 0)
+		st->stats.interval = 0;
+}
+
+
+/*
+ * life_display_cells() - Fit as many cells as possible in the window.
+ *
+ *	The cell size is reduced if need be so that at least 1 cluster fits.
+ */
+static
+void
+life_display_cells(struct state *st, Display *dpy,
+		   int *cell_numX, int *cell_numY)
+{
 
 	st->cellsize = get_integer_resource(dpy, "cellSize", "Integer");
 	if (st->cellsize < 1)
 		st->cellsize = 1;
 
 	for (;;) {
-		st->cell_numX = st->xgwa.width / st->cellsize;
-		st->cell_numY = st->xgwa.height / st->cellsize;
+		*cell_numX = st->xgwa.width / st->cellsize;
+		*cell_numY = st->xgwa.height / st->cellsize;
 
-		st->cluster_numX = st->cell_numX / CLUSTERSIZE;
-		st->cluster_numY = st->cell_numY / CLUSTERSIZE;
-
-		if (st->cluster_numX >= 1 && st->cluster_numY >= 1)
+		if (*cell_numX >= CLUSTERSIZE && *cell_numY >= CLUSTERSIZE)
 			break;
 
 		/*
@@ -286,915 +298,214 @@ life_state_init(struct state *st, Display *dpy)
 	if (st->celldrawsize > 1 &&
 	    get_boolean_resource(dpy, "cellBorder", "Boolean"))
 		st->celldrawsize--;
-
-	/*
-	 * Recompute the number of cells as a multiple of the number of
-	 * clusters.
-	 */
-	st->cell_numX = st->cluster_numX * CLUSTERSIZE;
-	st->cell_numY = st->cluster_numY * CLUSTERSIZE;
-
-	/* Center the cell display. */
-	st->display_offsetX = (st->xgwa.width -
-			       (st->cell_numX * st->cellsize)) / 2;
-	st->display_offsetY = (st->xgwa.height -
-			       (st->cell_numY * st->cellsize)) / 2;
-
-	/*
-	 * Allocate the cluster lookup table.  Initialize all pointers to
-	 * NULL to indicate an empty universe.
-	 */
-	st->maxcells = st->cell_numX * st->cell_numY;
-	st->maxclusters = st->cluster_numX * st->cluster_numY;
-	st->clustertable = calloc(st->maxclusters,
-				  sizeof(*st->clustertable));
-	if (st->clustertable == NULL)
-		exit(1);
-	st->numcells = 0;
-	st->numclusters = 0;
-	st->iteration = 0;
-}
-
-
-void
-life_state_free(struct state *st)
-{
-
-	free(st->clustertable);
-}
-
-
-void
-life_state_update(struct state *st)
-{
-	struct cell_cluster **clustertable = st->clustertable;
-	struct cell_cluster *cluster;
-	int clusteridx;
-	int numactive;
-
-	numactive = 0;
-	for (clusteridx = 0; clusteridx < st->maxclusters; clusteridx++) {
-		cluster = clustertable[clusteridx];
-		if (cluster == NULL)
-			continue;
-		if (cluster->dormant < LIMIT_UPDATE) {
-			life_cluster_update(st, cluster);
-			numactive++;
-			continue;
-		}
-		if (cluster->dormant < LIMIT_KEEPEMPTY) {
-			cluster->dormant++;
-			continue;
-		}
-		if (cluster->numcells == 0)
-			life_cluster_delete(st, cluster);
-	}
-
-	/* Try to keep the display at least 6.25% full. */
-	if (st->iteration % 256 == 0 ||
-	    st->numclusters * 16 < st->maxclusters)
-		life_pattern_draw(st);
-
-#ifdef LIFE_PRINTSTATS
-	fprintf(stderr,
-		"%03d/%03d clusters (%03d active: %02d%%); %05d/%05d cells\n",
-		st->numclusters, st->maxclusters, numactive,
-		numactive * 100 / st->maxclusters,
-		st->numcells, st->maxcells);
-#endif
-
-	st->iteration++;
-}
-
-
-static __inline
-void
-life_cluster_wakeneighbor(struct state *st, const struct cell_cluster *cluster,
-			  int xoffset, int yoffset)
-{
-	life_cluster_new(st, cluster->clusterX + xoffset,
-			 cluster->clusterY + yoffset);
-}
-
-
-void
-life_cluster_update(struct state *st, struct cell_cluster *cluster)
-{
-	cell state[CLUSTERSIZE + 2][CLUSTERSIZE + 2];
-	struct cell_cluster *neighbor;
-	int cellX, cellY;
-	int x, y, count;
-	int cellval, color;
-	unsigned int changemapX, changemapY;
-	int deaths, births;
-	int sum;
-	int idx;
-
-	changemapX = changemapY = 0;
-	deaths = births = 0;
-	memset(state, CELL_DEAD, sizeof(state));
-
-	/*
-	 * First populate the simulation state buffer.  The edges come from
-	 * neighboring clusters.
-	 */
-	if ((neighbor = cluster->neighbor[NORTHWEST]) != NULL)
-		state[0][0] = neighbor->oldcell[CLUSTERSIZE-1][CLUSTERSIZE-1];
-
-	if ((neighbor = cluster->neighbor[NORTHEAST]) != NULL)
-		state[0][CLUSTERSIZE+1] = neighbor->oldcell[CLUSTERSIZE-1][0];
-
-	if ((neighbor = cluster->neighbor[SOUTHWEST]) != NULL)
-		state[CLUSTERSIZE+1][0] = neighbor->oldcell[0][CLUSTERSIZE-1];
-
-	if ((neighbor = cluster->neighbor[SOUTHEAST]) != NULL)
-		state[CLUSTERSIZE+1][CLUSTERSIZE+1] = neighbor->oldcell[0][0];
-
-	if ((neighbor = cluster->neighbor[NORTH]) != NULL) {
-		memcpy(&state[0][1], &neighbor->oldcell[CLUSTERSIZE-1][0],
-		       CLUSTERSIZE * sizeof(cell));
-	}
-
-	if ((neighbor = cluster->neighbor[SOUTH]) != NULL) {
-		memcpy(&state[CLUSTERSIZE + 1][1], &neighbor->oldcell[0][0],
-		       CLUSTERSIZE * sizeof(cell));
-	}
-
-	if ((neighbor = cluster->neighbor[WEST]) != NULL) {
-		for (idx = 0; idx < CLUSTERSIZE; idx++)
-			state[idx+1][0] = neighbor->oldcell[idx][CLUSTERSIZE-1];
-	}
-
-	if ((neighbor = cluster->neighbor[EAST]) != NULL) {
-		for (idx = 0; idx < CLUSTERSIZE; idx++)
-			state[idx+1][CLUSTERSIZE+1] = neighbor->oldcell[idx][0];
-	}
-
-	/* Copy the middle from the current cluster's old cell state. */
-	for (idx = 0; idx < CLUSTERSIZE; idx++) {
-		memcpy(&state[idx+1][1], &cluster->oldcell[idx][0],
-		       CLUSTERSIZE * sizeof(cell));
-	}
-
-	/*
-	 * Now, we can calculate the current state for this cluster.
-	 */
-	for (cellY = 0; cellY < CLUSTERSIZE; cellY++) {
-		for (cellX = 0; cellX < CLUSTERSIZE; cellX++) {
-
-			cellval = state[cellY + 1][cellX + 1];
-			count = sum = 0;
-
-			/*
-			 * Examine each neighbor; offset by 1 due to padding in
-			 * local state buffer.
-			 */
-			for (y = cellY; y <= cellY + 2; y++) {
-				for (x = cellX; x <= cellX + 2; x++) {
-					if (state[y][x] != CELL_DEAD) {
-						sum += state[y][x] - CELL_MINALIVE;
-						count++;
-					}
-				}
-			}
-
-			if (cellval != CELL_DEAD) {
-				/*
-				 * Survival of existing cell unless it has
-				 * reached its maximum age.
-				 * Note that count includes the cell itself.
-				 */
-				if ((count == 3 || count == 4) &&
-				    (st->cellmaxage == 0 ||
-				     ++cluster->cellage[cellY][cellX] < st->cellmaxage))
-					continue;
-
-				/* Otherwise, death. */
-				cluster->cell[cellY][cellX] = CELL_DEAD;
-				cluster->cellage[cellY][cellX] = 0;
-				deaths++;
-
-				changemapX |= 1 << cellX;
-				changemapY |= 1 << cellY;
-
-				continue;
-			}
-
-			if (count != 3)
-				continue;
-
-			/*
-			 * Cell birth.
-			 * Calculate color by averaging neighbors' plus some
-			 * randomness.  The color index only increases until
-			 * wrap-around.  Due to integer truncation, the odds
-			 * of increasing the color are 1/4 (random % 8 must
-			 * be either 6 or 7).
-			 */
-			color = ((sum << 1) + (random() % 0x07)) / 6;
-			if (color >= st->colorwrap)
-				color = 0;
-			cluster->cell[cellY][cellX] = color + CELL_MINALIVE;
-			births++;
-
-			changemapX |= 1 << cellX;
-			changemapY |= 1 << cellY;
-		}
-	}
-
-	if (births == 0 && deaths == 0) {
-		/* Dormant cluster. */
-		cluster->dormant++;
-		return;
-	}
-
-	cluster->numcells += births - deaths;
-	st->numcells += births - deaths;
-#if 0
-	fprintf(stderr, "[%p] births = %d, deaths = %d, numcells = %d\n",
-			cluster, births, deaths, cluster->numcells);
-#endif
-
-	assert(cluster->numcells >= 0);
-	cluster->dormant = 0;
-
-	/*
-	 * Finally, if there were any changes along the edges, wake the
-	 * adjacent neighbor clusters because it will affect them too next
-	 * iteration.  This isn't just an optimization: since
-	 * life_state_update() only scans non-dormant clusters, if we didn't
-	 * wake them then we would never detect spill-over at all.
-	 */
-	if (changemapY & (1 << 0)) {
-		if (cluster->cell[0][0] != CELL_DEAD)
-			life_cluster_wakeneighbor(st, cluster, -1, -1);	/* NW */
-		life_cluster_wakeneighbor(st, cluster, 0, -1);		/* N */
-		if (cluster->cell[0][CLUSTERSIZE-1] != CELL_DEAD)
-			life_cluster_wakeneighbor(st, cluster, 1, -1);	/* NE */
-	}
-	if (changemapX & (1 << 0))
-		life_cluster_wakeneighbor(st, cluster, -1 ,0);		/* W */
-	if (changemapX & (1 << (CLUSTERSIZE-1))) 
-		life_cluster_wakeneighbor(st, cluster, 1, 0);		/* E */
-	if (changemapY & (1 << (CLUSTERSIZE-1))) {
-		if (cluster->cell[0][CLUSTERSIZE-1] != CELL_DEAD)
-			life_cluster_wakeneighbor(st, cluster, -1, 1);	/* SW */
-		life_cluster_wakeneighbor(st, cluster, 0, 1);		/* S */
-		if (cluster->cell[0][CLUSTERSIZE-1] != CELL_DEAD)
-			life_cluster_wakeneighbor(st, cluster, 1, 1);	/* SE */
-	}
-}
-
-
-struct cell_cluster *
-life_cluster_new(struct state *st, int clusterX, int clusterY)
-{
-	struct cell_cluster **clustertable = st->clustertable;
-	struct cell_cluster *cluster;
-	struct cell_cluster *neighbor;
-	int clusteridx;
-	int neighboridx;
-	int neighborX, neighborY;
-	int x, y;
-
-	int cluster_numX = st->cluster_numX;
-	int cluster_numY = st->cluster_numY;
-
-	if (clusterX == -1)
-		clusterX += cluster_numX;
-	if (clusterX == cluster_numX)
-		clusterX = 0;
-
-	if (clusterY == -1)
-		clusterY += cluster_numY;
-	if (clusterY == cluster_numY)
-		clusterY = 0;
-
-	assert(clusterX >= 0 && clusterX < cluster_numX);
-	assert(clusterY >= 0 && clusterY < cluster_numY);
-
-	clusteridx = (clusterY * cluster_numX) + clusterX;
-	assert(clusteridx >= 0 && clusteridx < st->maxclusters);
-	if ((cluster = clustertable[clusteridx]) != NULL) {
-		/* Matches existing cluster; wake it if it is dormant. */
-		cluster->dormant = 0;
-		return (cluster);
-	}
-
-	cluster = calloc(1, sizeof(*cluster));
-	if (cluster == NULL)
-		exit (1);
-
-	clustertable[clusteridx] = cluster;
-	st->numclusters++;
-	cluster->clusterX = clusterX;
-	cluster->clusterY = clusterY;
-
-	/*
-	 * Cache pointers to neighboring clusters.  All universe-wrapping logic
-	 * is done here so we don't have to do it in the speed-critical
-	 * simulation loop.
-	 */
-	neighboridx = 0;
-	for (y = clusterY - 1; y <= clusterY + 1; y++) {
-
-		if (y < 0)
-			neighborY = cluster_numY - 1;
-		else if (y >= cluster_numY)
-			neighborY = 0;
-		else
-			neighborY = y;
-
-		for (x = clusterX - 1; x <= clusterX + 1; x++, neighboridx++) {
-			if (x == clusterX && y == clusterY) {
-				neighboridx--;
-				continue;
-			}
-
-			if (x < 0)
-				neighborX = cluster_numX - 1;
-			else if (x >= cluster_numX)
-				neighborX = 0;
-			else
-				neighborX = x;
-
-			neighbor = clustertable[(neighborY * cluster_numX) +
-						neighborX];
-			cluster->neighbor[neighboridx] = neighbor;
-
-			if (neighbor == NULL)
-				continue;
-
-			/*
-			 * Update our neighbor with a link back to this new
-			 * cluster.  This relies on direction (X) and direction
-			 * (NUMDIRECTIONS - X - 1) being opposites.
-			 * Note that with large cell sizes, clusters may be
-			 * their own neighbor.
-			 */
-			assert(neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] == NULL ||
-			       neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] == cluster);
-			neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] = cluster;
-		}
-	}
-
-	return (cluster);
-}
-
-
-void
-life_cluster_delete(struct state *st, struct cell_cluster *cluster)
-{
-	struct cell_cluster *neighbor;
-	int clusteridx;
-	int neighboridx;
-
-	assert(cluster->numcells == 0);
-	assert(st->numclusters > 0);
-
-	for (neighboridx = 0; neighboridx < NUMDIRECTIONS; neighboridx++) {
-		neighbor = cluster->neighbor[neighboridx];
-		if (neighbor == NULL)
-			continue;
-
-		/*
-		 * Clear our neighbors' link to this cluster.  This relies on
-		 * direction (X) and direction (NUMDIRECTIONS - X - 1) being
-		 * opposites.
-		 */
-		assert(neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] != NULL);
-		neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] = NULL;
-	}
-
-	clusteridx = (cluster->clusterY * st->cluster_numX) +
-		     cluster->clusterX;
-	st->clustertable[clusteridx] = NULL;
-	st->numclusters--;
-	free(cluster);
 }
 
 
+/*
+ * life_display_layout() - Place the simulation's view in the window.
+ */
 static
 void
-life_cluster_draw(const struct state * const st, Display *dpy, Window window,
-		  const struct cell_cluster * const cluster,
-		  int xstart, int ystart)
+life_display_layout(struct state *st)
 {
-	const XColor *trailcolors = st->trailcolors;
-	const XColor *colors = st->colors;
-	int xoffset, yoffset;
-	int cellX, cellY;
-	int cellidx;
 
-	cellidx = 0;
-	for (cellY = 0, yoffset = ystart;
-	     cellY < CLUSTERSIZE;
-	     cellY++, yoffset += st->cellsize) {
-
-		for (cellX = 0, xoffset = xstart;
-		     cellX < CLUSTERSIZE;
-		     cellX++, xoffset += st->cellsize) {
-
-			GC context = st->gc_draw;
-			cell c = cluster->cell[cellY][cellX];
-
-			if (c == CELL_DEAD) {
-				c = cluster->oldcell[cellY][cellX];
-				if (c == CELL_DEAD)
-					continue;
-				if (trailcolors != NULL) {
-					XSetForeground(dpy, st->gc_draw,
-						       trailcolors[c].pixel);
-				} else {
-					context = st->gc_erase;
-				}
-			} else {
-				/* Live cell. */
-				if (cluster->oldcell[cellY][cellX] == c)
-					continue;	/* No change. */
-				XSetForeground(dpy, st->gc_draw,
-					       colors[c].pixel);
-			}
-
-			XFillRectangle(dpy, st->buf, context, xoffset, yoffset,
-				       st->celldrawsize, st->celldrawsize);
-		}
+	/* Center the cell display. */
+	st->display_offsetX = (st->xgwa.width -
+			       (st->life.cell_numX * st->cellsize)) / 2;
+	st->display_offsetY = (st->xgwa.height -
+			       (st->life.cell_numY * st->cellsize)) / 2;
+
+	/* Track damage if the display is copied from a pixmap. */
+	free(st->damage);
+	st->damage = NULL;
+	st->damageall = True;
+	if (st->pixmap != None) {
+		st->damage = calloc(st->life.maxclusters,
+				    sizeof(*st->damage));
+		if (st->damage == NULL)
+			exit(1);
 	}
 }
 
 
 /*
- * life_cell_set() - Sets a cell to alive.
- *
- *	This interface, while general, is horribly inefficient.  It is only
- *	used to draw patterns which are specified by coordinates.  Anything
- *	in the fast-path should avoid this routine like the plague.
- *
- *	In this case, color should be a number between 0 and numcolors.  We'll
- *	take care of adjusting it to avoid the CELL_DEAD "color".
+ * life_bucket_grow() - Make room for more rectangles in a fill bucket.
  */
-void
-life_cell_set(struct state *st, int x, int y, int color)
-{
-	struct cell_cluster *cluster;
-	int clusterX, clusterY;
-
-	/*
-	 * First, handle wrapping of the X and Y coordinates.
-	 */
-	while (x < 0)
-		x += st->cell_numX;
-	while (x >= st->cell_numX)
-		x -= st->cell_numX;
-	while (y < 0)
-		y += st->cell_numY;
-	while (y >= st->cell_numY)
-		y -= st->cell_numY;
-
-	/*
-	 * Handle wrapping of the color coordinate also.
-	 * Note that this routine cannot be called to kill cells.
-	 */
-	while (color <= CELL_MINALIVE)
-		color += st->numcolors;
-	while (color >= st->colorwrap)
-		color -= st->colorwrap;
-
-	/* Now convert into <cluster, cell> coordinates. */
-	clusterX = x / CLUSTERSIZE;
-	clusterY = y / CLUSTERSIZE;
-	x = x % CLUSTERSIZE;
-	y = y % CLUSTERSIZE;
-
-	cluster = life_cluster_new(st, clusterX, clusterY);
-
-	if (cluster->cell[y][x] != CELL_DEAD) {
-		/* Already a cell there.  Let's merge them. */
-		cluster->cell[y][x] = CELL_MINALIVE +
-			((cluster->cell[y][x] - CELL_MINALIVE + color) / 2);
-		return;
-	}
-
-	cluster->cell[y][x] = color + CELL_MINALIVE;
-	cluster->numcells++;
-	st->numcells++;
-
-	cluster->dormant = 0;
-	if (y == 0) {
-		if (x == 0)
-			life_cluster_wakeneighbor(st, cluster, -1, -1);	/* NW */
-		life_cluster_wakeneighbor(st, cluster, 0, -1);		/* N */
-		if (x == CLUSTERSIZE - 1)
-			life_cluster_wakeneighbor(st, cluster, 1, -1);	/* NE */
-	}
-	if (x == 0)
-		life_cluster_wakeneighbor(st, cluster, -1 ,0);		/* W */
-	if (x == CLUSTERSIZE - 1) 
-		life_cluster_wakeneighbor(st, cluster, 1, 0);		/* E */
-	if (y == CLUSTERSIZE - 1) {
-		if (x == 0)
-			life_cluster_wakeneighbor(st, cluster, -1, 1);	/* SW */
-		life_cluster_wakeneighbor(st, cluster, 0, 1);		/* S */
-		if (x == CLUSTERSIZE - 1)
-			life_cluster_wakeneighbor(st, cluster, 1, 1);	/* SE */
-	}
-}
-
-
-void
-life_pattern_init(struct state *st, Display *dpy)
-{
-	char *patternfiles[NUMPATTERNS];
-	char *pattern_path;
-	char *pattern_dir;
-	int count;
-	int pos;
-	size_t len;
-
-	count = 0;
-	memset(patternfiles, 0, sizeof(patternfiles));
-
-	/*
-	 * First, build a list of NUMPATTERNS files to read from.  It is
-	 * possible that not all of the files contain usable patterns; we have
-	 * some built-in patterns, though.
-	 */
-	pattern_path = get_string_resource(dpy, "patternPath", "String");
-	while ((pattern_dir = strsep(&pattern_path, ":")) != NULL) {
-		struct dirent *entry;
-		DIR *dir;
-
-		/* Trim trailing slashes off of the directory name. */
-		len = strlen(pattern_dir);
-		while (len > 0 && pattern_dir[len - 1] == '/') {
-			pattern_dir[len - 1] = '\0';
-			len--;
-		}
-
-		dir = opendir(pattern_dir);
-		if (dir == NULL)
-			continue;
-
-		while ((entry = readdir(dir)) != NULL) {
-			if (entry->d_type != DT_REG)
-				continue;
-
-			pos = random() % (count + 2);	/* XXX Magic Hack */
-			if (pos >= NUMPATTERNS)
-				continue;
-
-			if (patternfiles[pos] != NULL)
-				free(patternfiles[pos]);
-
-			len = strlen(pattern_dir) + 1 + entry->d_namlen + 1;
-			patternfiles[pos] = malloc(len);
-			if (patternfiles[pos] == NULL)
-				continue;
-
-			snprintf(patternfiles[pos], len, "%s/%s", pattern_dir,
-				 entry->d_name);
-			count++;
-		}
-
-		closedir(dir);
-	}
-
-	/*
-	 * Initialize pattern list with built-in patterns.
-	 */
-	memcpy(st->patterns, builtin_patterns, sizeof(builtin_patterns));
-
-	/*
-	 * Now, try to load a pattern from each of the selected files until we
-	 * have NUMPATTERNS (including builtins).
-	 */
-	count = NUMPATTERNSBUILTIN;
-	pos = 0;
-	while (count < NUMPATTERNS && pos < NUMPATTERNS) {
-		if (life_pattern_read(st, patternfiles[pos],
-				      &st->patterns[count])) {
-			count++;
-#ifdef LIFE_PRINTPATTERNS
-			fprintf(stderr, "Loaded pattern %s\n",
-				patternfiles[pos]);
-#endif
-		}
-		pos++;
-	}
-
-	/* Pad out empty entries in the pattern array. */
-	for (pos = 0; count < NUMPATTERNS; pos++, count++)
-		st->patterns[count] = st->patterns[pos];
-
-	/* Free memory allocated to filenames. */
-	for (pos = 0; pos < NUMPATTERNS; pos++) {
-		if (patternfiles[pos] != NULL)
-			free(patternfiles[pos]);
-	}
-}
-
-
-void
-life_pattern_free(struct state *st)
-{
-	struct coords *coords0;
-	int i;
-
-	/*
-	 * The pattern array is always padded out to NUMPATTERNS entries
-	 * by duplicating patterns as necessary.  In addition, the first
-	 * NUMPATTERNSBUILTIN patterns are static and do not need freeing.
-	 * As such, we free the patterns starting at index NUMPATTERNSBUILTIN
-	 * and continueing through the array until we see pattern #0
-	 * duplicated or we free NUMPATTERNS, whichever comes first.
-	 */
-	coords0 = st->patterns[0].coords;
-
-	for (i = NUMPATTERNSBUILTIN; i < NUMPATTERNS; i++) {
-		if (st->patterns[i].coords == coords0)
-			break;
-		free(st->patterns[i].coords);
-	}
-}
-
-
-static __inline
-int
-randbit(void)
-{
-	static unsigned int randbits;
-	static int randcount = 0;
-	int rv;
-
-	if (randcount == 0) {
-		randbits = random();
-		randcount = 32;		/* Good for 32 bits. */
-	}
-
-	rv = randbits & 0x01;
-	randbits >>= 1;
-	return (rv);
-}
-
-
-void
-life_pattern_draw(struct state *st)
-{
-	struct cell_cluster *cluster;
-	struct pattern *pattern;
-	const struct coords *coord, *endcoord;
-	int cellX, cellY;
-	int color;
-	int clusterX, clusterY;
-	int clusteridx;
-	int lastneeded;
-	int tries;
-
-	/*
-	 * First, find an empty cluster.
-	 * We don't strictly need an empty cluster, but finding one is a good
-	 * sign of a fairly sparsly populated region of the screen.
-	 */
-	for (tries = 5; tries > 0; tries--) {
-		clusteridx = random() % st->maxclusters;
-		cluster = st->clustertable[clusteridx];
-		if (cluster == NULL)
-			break;
-	}
-
-	/* Didn't find an empty cluster.  Hope for better luck next time... */
-	if (tries == 0)
-		return;
-
-	clusterY = clusteridx / st->cluster_numX;
-	clusterX = clusteridx % st->cluster_numX;
-	cellY = (clusterY * CLUSTERSIZE) + (random() % CLUSTERSIZE);
-	cellX = (clusterX * CLUSTERSIZE) + (random() % CLUSTERSIZE);
-
-	/*
-	 * Pick a random pattern.
-	 * Tries up to 5 times to find a pattern that fits in the amount of
-	 * empty space available.  Since we don't yet know how the pattern
-	 * will be rotated, check both dimensions for the maximum required
-	 * space.
-	 */
-	lastneeded = INT_MAX;
-	for (tries = 5; tries > 0; tries--) {
-		int needX, needY, needed;
-		int scanX, scanY;
-
-		pattern = &st->patterns[random() % NUMPATTERNS];
-
-		needX = ((cellX % CLUSTERSIZE) + pattern->width) / CLUSTERSIZE;
-		needY = ((cellY % CLUSTERSIZE) + pattern->height) / CLUSTERSIZE;
-		needed = needX > needY ? needX : needY;
-
-		if (needed == 1)	/* Fits in initial cluster. */
-			break;
-
-		/*
-		 * If this pattern is the same size or larger than the previous
-		 * then we don't have a chance of succeeding.
-		 */
-		if (needed >= lastneeded)
-			continue;
-
-		for (needY = 1; needY < needed; needY++) {
-			scanY = clusterY + needY;
-			if (scanY >= st->cluster_numY)
-				scanY -= st->cluster_numY;
-
-			for (needX = 1; needX < needed; needX++) {
-				scanX = clusterX + needX;
-				if (scanX >= st->cluster_numX)
-					scanX -= st->cluster_numX;
-
-				clusteridx = (scanY * st->cluster_numX) +
-					     scanX;
-			        assert(clusteridx >= 0 &&
-				       clusteridx < st->maxclusters);
-				cluster = st->clustertable[clusteridx];
-
-				if (cluster != NULL && cluster->numcells > 0)
-					goto noFit;
-			}
-		}
-
-		/* We found a pattern which fits in the empty region. */
-		break;
-
-noFit:
-		/*
-		 * This pattern won't fit, try another pattern in the list.
-		 */
-		lastneeded = needed;
-
-	}
-	coord = pattern->coords;
-	endcoord = pattern->coords + pattern->numcoords;
-
-	/*
-	 * Write pattern.
-	 */
-
-	color = random() % st->numcolors;
+static
+void
+life_bucket_grow(struct life_fillbucket *bucket)
+{
 
-	switch (random() % 4) {
-	case 0:
-		for (; coord < endcoord; coord++) {
-			life_cell_set(st, cellX + coord->x,
-					  cellY + coord->y, color);
-			color += randbit();
-		}
-		break;
+	bucket->maxrects = bucket->maxrects != 0 ? bucket->maxrects * 2 : 64;
+	bucket->rects = realloc(bucket->rects,
+				bucket->maxrects * sizeof(*bucket->rects));
+	if (bucket->rects == NULL)
+		exit(1);
+}
 
-	case 1:
-		/* Rotate 90 degrees. */
-		for (; coord < endcoord; coord++) {
-			life_cell_set(st, cellX + coord->y,
-				          cellY + coord->x, color);
-			color += randbit();
-		}
-		break;
 
-	case 2:
-		/* Flip vertically. */
-		for (; coord < endcoord; coord++) {
-			life_cell_set(st, cellX + coord->x,
-					  cellY + pattern->width - coord->y,
-					  color);
-			color += randbit();
+/*
+ * life_image_fill() - Fill a rectangle of the image with a pixel value.
+ */
+static __inline
+void
+life_image_fill(struct state *st, int x, int y, int width, int height,
+		unsigned long pixel)
+{
+	XImage *image = st->ximage;
+	uint32_t *row;
+	int i, j;
+
+	if (st->imagedirect) {
+		for (j = y; j < y + height; j++) {
+			row = (uint32_t *)(image->data +
+					   j * image->bytes_per_line);
+			for (i = x; i < x + width; i++)
+				row[i] = pixel;
 		}
-		break;
-
-	case 3:
-		/* Rotate -90 degrees. */
-		for (; coord < endcoord; coord++) {
-			life_cell_set(st, cellX + pattern->width - coord->y,
-					  cellY + coord->x, color);
-			color += randbit();
+	} else {
+		for (j = y; j < y + height; j++) {
+			for (i = x; i < x + width; i++)
+				XPutPixel(image, i, j, pixel);
 		}
-		break;
+	}
 
-	default:
-		assert(0);
-		/* NOTREACHED */
+	if (st->dirtyX1 >= st->dirtyX2) {
+		st->dirtyX1 = x;
+		st->dirtyY1 = y;
+		st->dirtyX2 = x + width;
+		st->dirtyY2 = y + height;
+		return;
 	}
+	if (x < st->dirtyX1)
+		st->dirtyX1 = x;
+	if (y < st->dirtyY1)
+		st->dirtyY1 = y;
+	if (x + width > st->dirtyX2)
+		st->dirtyX2 = x + width;
+	if (y + height > st->dirtyY2)
+		st->dirtyY2 = y + height;
 }
 
 
 /*
- * life_pattern_read() - Parse a pattern stored in a Life 1.05 format file.
+ * life_cell_draw() - Queue a cell to be drawn if it changed since it was
+ *		      last drawn.
  *
- *	If the file is an unknown format or the pattern is too large, then
- *	returns boolean false.  Otherwise, returns boolean true and populates
- *	the given pattern structure with data from the file.
- *	A good collection of Life 1.05 format patterns can be found at
- *		http://www.ibiblio.org/lifepatterns/#patterns
+ *	Cells which died are drawn in their trail color, if trails are
+ *	enabled, and erased otherwise.  Nothing is actually drawn until
+ *	life_display_flush(), except with the image renderer where the
+ *	pixels are stored right away.
  */
-int
-life_pattern_read(const struct state * const st, const char *filename,
-		  struct pattern *pattern)
+static __inline
+void
+life_cell_draw(struct state *st, cell c, cell prev, int xoffset, int yoffset)
 {
-	struct coords coordbuf[PATTERN_MAXCOORDS];
-	struct coords linecoord, mincoord, maxcoord;
-	struct coords *coord;
-
-	char line[128];
-	char *pos, *endptr;
-	FILE *f;
-	size_t len;
-
-	maxcoord.x = maxcoord.y = INT_MIN;
-	mincoord.x = mincoord.y = INT_MAX;
+	struct life_fillbucket *bucket;
+	XRectangle *rect;
+
+	if (st->ximage != NULL) {
+		if (c == prev)
+			return;
+		life_image_fill(st, xoffset, yoffset,
+				st->celldrawsize, st->celldrawsize,
+				c != CELL_DEAD ? st->colors[c].pixel :
+				st->trailcolors != NULL ?
+				    st->trailcolors[prev].pixel : st->bgpixel);
+		return;
+	}
 
-	f = fopen(filename, "r");
-	if (f == NULL)
-		return (False);
+	if (c == CELL_DEAD) {
+		if (prev == CELL_DEAD)
+			return;
+		if (st->trailcolors != NULL) {
+			bucket = &st->buckets[st->numcolors +
+			    (prev - CELL_MINALIVE) % st->numcolors];
+		} else {
+			bucket = &st->buckets[st->numcolors * 2];
+		}
+	} else {
+		/* Live cell. */
+		if (prev == c)
+			return;		/* No change. */
+		bucket = &st->buckets[(c - CELL_MINALIVE) % st->numcolors];
+	}
 
-	pattern->numcoords = 0;
-	coord = coordbuf;
+	if (bucket->numrects == bucket->maxrects)
+		life_bucket_grow(bucket);
+	rect = &bucket->rects[bucket->numrects++];
+	rect->x = xoffset;
+	rect->y = yoffset;
+	rect->width = st->celldrawsize;
+	rect->height = st->celldrawsize;
+}
 
-	while (fgets(line, sizeof(line), f) != NULL) {
-		if (line[0] == '#') {
-			/* We only (barely) understand #P lines. */
-			if (line[1] != 'P')
-				continue;
 
-			linecoord.x = strtol(line + 2, &endptr, 10);
-			linecoord.y = strtol(endptr, &endptr, 10);
-			coord->y = linecoord.y;
+static
+void
+life_cluster_draw(struct state *st, Display *dpy, Window window,
+		  const struct cell_cluster * const cluster,
+		  int xstart, int ystart, int redraw)
+{
+	const cell (*cells)[CLUSTERSIZE] = LIFE_CURGEN(&st->life, cluster);
+	const cell (*prevcells)[CLUSTERSIZE] = LIFE_NEXTGEN(&st->life, cluster);
+	int xoffset, yoffset;
+	int cellX, cellY;
+	int cellidx;
 
-			if (linecoord.x < mincoord.x)
-				mincoord.x = linecoord.x;
-			if (linecoord.y < mincoord.y)
-				mincoord.y = linecoord.y;
-			continue;
-		}
+	/* Compare against the cells as last drawn, if they are kept. */
+	if (cluster->drawn != NULL)
+		prevcells = (const cell (*)[CLUSTERSIZE])cluster->drawn;
 
-		coord->x = linecoord.x;
-		for (pos = line; *pos != '\0'; pos++) {
-			if (*pos == '*') {
-				if (coord->x > maxcoord.x)
-					maxcoord.x = coord->x;
-				if (coord->y > maxcoord.y)
-					maxcoord.y = coord->y;
-
-				coord++;
-				pattern->numcoords++;
-				if (pattern->numcoords == PATTERN_MAXCOORDS) {
-					/* Too many coordinates in pattern. */
-					fclose(f);
-					return (False);
-				}
+	cellidx = 0;
+	for (cellY = 0, yoffset = ystart;
+	     cellY < CLUSTERSIZE;
+	     cellY++, yoffset += st->cellsize) {
 
-				/* Initialize the next coordinate. */
-				*coord = *(coord - 1);
-			}
-			coord->x++;
+		for (cellX = 0, xoffset = xstart;
+		     cellX < CLUSTERSIZE;
+		     cellX++, xoffset += st->cellsize) {
+			life_cell_draw(st, cells[cellY][cellX],
+				       redraw ? CELL_DEAD :
+						prevcells[cellY][cellX],
+				       xoffset, yoffset);
 		}
-		coord->y++;
 	}
 
-	fclose(f);
+	if (cluster->drawn != NULL)
+		memcpy(cluster->drawn, cells, sizeof(cluster->cells[0]));
+}
 
-	/* Ignore empty patterns. */
-	if (pattern->numcoords == 0)
-		return (False);
 
-	/*
-	 * Calculate the width of the pattern.
-	 * This is actually 1 less than the width, but every it is used had to
-	 * subtract 1 to get a useable value, so we just subtract the one here
-	 * and be done with it.
-	 */
-	pattern->width = maxcoord.x - mincoord.x;
-	pattern->height = maxcoord.y - mincoord.y;
+void
+life_hashlife_draw(struct state *st, Display *dpy)
+{
+	const struct life_state * const life = &st->life;
+	int xoffset, yoffset;
+	int cellX, cellY;
+	int cellidx;
 
-	/*
-	 * Don't bother with patterns which are too big to be displayed in
-	 * any meaningful manner.
-	 */
-	if (pattern->width > st->cell_numX / 2 ||
-	    pattern->height > st->cell_numY / 2)
-		return (False);
+	for (cellY = 0, cellidx = 0, yoffset = st->display_offsetY;
+	     cellY < life->cell_numY;
+	     cellY++, yoffset += st->cellsize) {
 
-	/*
-	 * Normalize the pattern's cell coordinates such that the minimum X
-	 * and Y values are both 0.
-	 */
-	for (; coord > coordbuf; coord--) {
-		coord->x -= mincoord.x;
-		coord->y -= mincoord.y;
+		for (cellX = 0, xoffset = st->display_offsetX;
+		     cellX < life->cell_numX;
+		     cellX++, cellidx++, xoffset += st->cellsize) {
+			if (life->hashcells[cellidx] ==
+			    life->hashdrawn[cellidx])
+				continue;
+			life_cell_draw(st, life->hashcells[cellidx],
+				       life->hashdrawn[cellidx],
+				       xoffset, yoffset);
+			if (st->damage != NULL)
+				st->damage[(cellY / CLUSTERSIZE) *
+					   life->cluster_numX +
+					   cellX / CLUSTERSIZE] = True;
+		}
 	}
 
-	/* Finally, copy the coordinate data into the pattern record. */
-	len = sizeof(struct coords) * pattern->numcoords;
-	pattern->coords = malloc(len);
-	if (pattern->coords == NULL)
-		return (False);
-	memcpy(pattern->coords, coordbuf, len);
-	return (True);
+	memcpy(life->hashdrawn, life->hashcells, life->maxcells * sizeof(cell));
 }
 
 
@@ -1202,6 +513,7 @@ void
 life_display_init(struct state *st, Display *dpy, Window window)
 {
 	XGCValues gcv;
+	char *renderer;
 	int leavetrails;
 	int i;
 
@@ -1306,9 +618,12 @@ alloccolors:
 
 	/*
 	 * Duplicate color pointers so that all colors appear in the list(s)
-	 * 3 times.
+	 * 3 times.  The duplicates share fill buckets.
 	 */
-	st->colorwrap = st->numcolors * 3;
+	st->numbuckets = (st->numcolors * 2) + 1;
+	st->buckets = calloc(st->numbuckets, sizeof(*st->buckets));
+	if (st->buckets == NULL)
+		exit(1);
 	for (i = 0; i < st->numcolors; i++) {
 		st->colors[(st->numcolors * 2) + i + CELL_MINALIVE] =
 		    st->colors[st->numcolors + i + CELL_MINALIVE] =
@@ -1325,6 +640,25 @@ alloccolors:
 	st->pixmap = None;
 	st->buf = None;
 	st->backbuf = None;
+	st->bgpixel = get_pixel_resource(dpy, st->xgwa.colormap,
+					 "background", "Background");
+
+	/*
+	 * The image renderer does its own buffering: cells are drawn into the
+	 * image and only copied to the window once a frame is complete.
+	 */
+	st->ximage = NULL;
+	renderer = get_string_resource(dpy, "renderer", "Renderer");
+	if (renderer != NULL) {
+		if (strcmp(renderer, "image") == 0)
+			life_image_init(st, dpy, window);
+		else if (strcmp(renderer, "fill") != 0)
+			fprintf(stderr, "%s: unknown renderer \"%s\"\n",
+				progname, renderer);
+		free(renderer);
+	}
+	if (st->ximage != NULL)
+		st->double_buffer = False;
 
 	if (st->double_buffer) {
 #ifdef HAVE_DOUBLE_BUFFER_EXTENSION
@@ -1351,8 +685,7 @@ alloccolors:
 		st->buf = window;
 	}
 
-	gcv.foreground = get_pixel_resource(dpy, st->xgwa.colormap,
-					    "background", "Background");
+	gcv.foreground = st->bgpixel;
 	st->gc_erase = XCreateGC(dpy, st->buf, GCForeground, &gcv);
 
 	gcv.background = gcv.foreground;
@@ -1379,6 +712,7 @@ alloccolors:
 void
 life_display_free(struct state *st, Display *dpy)
 {
+	int i;
 
 	free_colors(dpy, st->xgwa.colormap, st->colors, st->numcolors);
 	free(st->colors);
@@ -1389,54 +723,132 @@ life_display_free(struct state *st, Display *dpy)
 		free(st->trailcolors);
 	}
 
+	for (i = 0; i < st->numbuckets; i++)
+		free(st->buckets[i].rects);
+	free(st->buckets);
+
+	if (st->ximage != NULL)
+		life_image_free(st, dpy);
+
 	if (st->pixmap != None)
 		XFreePixmap(dpy, st->pixmap);
 }
 
 
+/*
+ * life_image_init() - Set up the image renderer.
+ *
+ *	The image is put in shared memory if the server supports it, unless
+ *	the useSHM resource says otherwise.  Leaves st->ximage NULL if no
+ *	image could be created, in which case the fill renderer is used.
+ */
+void
+life_image_init(struct state *st, Display *dpy, Window window)
+{
+	XImage *image = NULL;
+	union {
+		uint32_t word;
+		unsigned char bytes[4];
+	} order;
+
+#ifdef HAVE_XSHM_EXTENSION
+	st->use_shm = get_boolean_resource(dpy, "useSHM", "Boolean");
+	if (st->use_shm) {
+		image = create_xshm_image(dpy, st->xgwa.visual,
+					  st->xgwa.depth, ZPixmap, 0,
+					  &st->shm_info,
+					  st->xgwa.width, st->xgwa.height);
+		if (image == NULL)
+			st->use_shm = False;
+	}
+#endif /* HAVE_XSHM_EXTENSION */
+
+	if (image == NULL) {
+		image = XCreateImage(dpy, st->xgwa.visual, st->xgwa.depth,
+				     ZPixmap, 0, NULL,
+				     st->xgwa.width, st->xgwa.height, 8, 0);
+		if (image == NULL)
+			return;
+		image->data = malloc(image->height * image->bytes_per_line);
+		if (image->data == NULL)
+			exit(1);
+	}
+	st->ximage = image;
+
+	/* Store pixels directly if they are 32 bits in our byte order. */
+	order.word = 1;
+	st->imagedirect = image->bits_per_pixel == 32 &&
+	    image->byte_order == (order.bytes[0] == 1 ? LSBFirst : MSBFirst);
+
+	st->dirtyX1 = st->dirtyX2 = 0;
+	life_image_fill(st, 0, 0, st->xgwa.width, st->xgwa.height,
+			st->bgpixel);
+}
+
+
+void
+life_image_free(struct state *st, Display *dpy)
+{
+
+#ifdef HAVE_XSHM_EXTENSION
+	if (st->use_shm) {
+		XShmDetach(dpy, &st->shm_info);
+		XDestroyImage(st->ximage);
+		shmdt(st->shm_info.shmaddr);
+		st->ximage = NULL;
+		return;
+	}
+#endif /* HAVE_XSHM_EXTENSION */
+	XDestroyImage(st->ximage);
+	st->ximage = NULL;
+}
+
+
 void
 life_display_update(struct state *st, Display *dpy, Window window)
 {
-	struct cell_cluster ** clustertable = st->clustertable;
+	const struct life_state * const life = &st->life;
 	struct cell_cluster *cluster;
-	int clusterX, clusterY;
-	int clusteridx;
 	int xoffset, yoffset;
+	int viewX, viewY;
 
 	int clustersize = st->cellsize * CLUSTERSIZE;
 
 	/*
-	 * Draw cells.
+	 * Draw cells.  Only active clusters on the display can have changed;
+	 * there are none when the hashlife engine is used.
 	 */
-	clusteridx = 0;
-	for (clusterY = 0, yoffset = st->display_offsetY;
-	     clusterY < st->cluster_numY;
-	     clusterY++, yoffset += clustersize) {
-
-		for (clusterX = 0, xoffset = st->display_offsetX;
-		     clusterX < st->cluster_numX;
-		     clusterX++, xoffset += clustersize,
-				 clusteridx++) {
-
-			cluster = clustertable[clusteridx];
-			if (cluster == NULL || cluster->dormant > LIMIT_DRAW)
-				continue;
-
-			life_cluster_draw(st, dpy, window, cluster,
-					  xoffset, yoffset);
+	if (st->redraw)
+		life_display_redraw(st, dpy, window);
+	if (life->hashlife != NULL)
+		life_hashlife_draw(st, dpy);
+	TAILQ_FOREACH(cluster, &life->active, link) {
+		if (cluster->dormant > life->limitdraw || st->redraw ||
+		    !life_cluster_visible(life, cluster->clusterX,
+					  cluster->clusterY, &viewX, &viewY))
+			continue;
 
-			/*
-			 * Now that we've drawn the state; record it as the old
-			 * state so we can calculate the next iteration.
-			 */
-			memcpy(cluster->oldcell, cluster->cell,
-			       sizeof(cluster->cell));
-		}
+		xoffset = st->display_offsetX + viewX * clustersize;
+		yoffset = st->display_offsetY + viewY * clustersize;
+		life_cluster_draw(st, dpy, window, cluster, xoffset, yoffset,
+				  False);
+		if (st->damage != NULL)
+			st->damage[viewY * life->cluster_numX + viewX] = True;
 	}
+	st->redraw = False;
+	life_display_flush(st, dpy);
+}
+
+
+/*
+ * life_display_swap() - Show what life_display_update() drew.
+ *
+ *	Switches the draw buffer to the display buffer, if double-buffering.
+ */
+void
+life_display_swap(struct state *st, Display *dpy, Window window)
+{
 
-	/*
-	 * Switch draw buffer to display buffer (if double-buffering).
-	 */
 #ifdef HAVE_DOUBLE_BUFFER_EXTENSION
 	if (st->backbuf != None) {
 		XdbeSwapBuffers(dpy, &st->swapinfo, 1);
@@ -1445,12 +857,252 @@ life_display_update(struct state *st, Display *dpy, Window window)
 #endif
 	if (st->double_buffer) {
 		/* We are doing software double-buffering. */
+		life_display_present(st, dpy, window);
+	}
+}
+
+
+/*
+ * life_damage_merge() - Merge damaged clusters into rectangles.
+ *
+ *	The display is divided into square blocks of scale clusters per
+ *	side.  Runs of damaged blocks in each row become rectangles, which
+ *	are extended downwards while the rows below have runs at the same
+ *	columns.  Returns the number of rectangles, in cluster units, or -1
+ *	if more than LIFE_MAXDAMAGE would be needed.
+ */
+static
+int
+life_damage_merge(const struct state * const st, int scale,
+		  XRectangle *rects)
+{
+	const struct life_state * const life = &st->life;
+	XRectangle *rect;
+	int numblocksX, numblocksY;
+	int numrects;
+	int blockX, blockY, runX;
+	int x, y;
+	int i;
+
+	numblocksX = (life->cluster_numX + scale - 1) / scale;
+	numblocksY = (life->cluster_numY + scale - 1) / scale;
+	numrects = 0;
+	for (blockY = 0; blockY < numblocksY; blockY++) {
+		runX = -1;
+		for (blockX = 0; blockX <= numblocksX; blockX++) {
+			/* Is any cluster in this block damaged? */
+			for (y = blockY * scale;
+			     blockX < numblocksX && y < (blockY + 1) * scale &&
+			     y < life->cluster_numY; y++) {
+				for (x = blockX * scale;
+				     x < (blockX + 1) * scale &&
+				     x < life->cluster_numX; x++) {
+					if (st->damage[y * life->cluster_numX +
+						       x])
+						goto damaged;
+				}
+			}
+
+			/* Not damaged; end the current run, if any. */
+			if (runX < 0)
+				continue;
+			for (i = 0; i < numrects; i++) {
+				rect = &rects[i];
+				if (rect->x == runX &&
+				    rect->width == blockX - runX &&
+				    rect->y + rect->height == blockY)
+					break;
+			}
+			if (i < numrects) {
+				rects[i].height++;
+			} else {
+				if (numrects == LIFE_MAXDAMAGE)
+					return (-1);
+				rect = &rects[numrects++];
+				rect->x = runX;
+				rect->y = blockY;
+				rect->width = blockX - runX;
+				rect->height = 1;
+			}
+			runX = -1;
+			continue;
+damaged:
+			if (runX < 0)
+				runX = blockX;
+		}
+	}
+
+	/* Convert to cluster units. */
+	for (i = 0; i < numrects; i++) {
+		rects[i].x *= scale;
+		rects[i].y *= scale;
+		rects[i].width *= scale;
+		rects[i].height *= scale;
+	}
+	return (numrects);
+}
+
+
+/*
+ * life_display_present() - Copy the damaged part of the pixmap to the window.
+ *
+ *	If the damage cannot be described in LIFE_MAXDAMAGE rectangles, it
+ *	is tracked in coarser blocks of clusters until it can.
+ */
+void
+life_display_present(struct state *st, Display *dpy, Window window)
+{
+	XRectangle rects[LIFE_MAXDAMAGE];
+	int numrects;
+	int x, y, width, height;
+	int scale;
+	int i;
+
+	int clustersize = st->cellsize * CLUSTERSIZE;
+
+	if (st->damage == NULL || st->damageall) {
 		XCopyArea(dpy, st->buf, window, st->gc_draw, 0, 0,
 			  st->xgwa.width, st->xgwa.height, 0, 0);
+		if (st->damage != NULL)
+			memset(st->damage, False, st->life.maxclusters);
+		st->damageall = False;
+		return;
+	}
+
+	scale = 1;
+	while ((numrects = life_damage_merge(st, scale, rects)) < 0)
+		scale *= 2;
+	memset(st->damage, False, st->life.maxclusters);
+
+	for (i = 0; i < numrects; i++) {
+		x = rects[i].x;
+		y = rects[i].y;
+		width = rects[i].width;
+		height = rects[i].height;
+
+		/* Blocks may hang over the edge of the display. */
+		if (x + width > st->life.cluster_numX)
+			width = st->life.cluster_numX - x;
+		if (y + height > st->life.cluster_numY)
+			height = st->life.cluster_numY - y;
+
+		XCopyArea(dpy, st->buf, window, st->gc_draw,
+			  st->display_offsetX + x * clustersize,
+			  st->display_offsetY + y * clustersize,
+			  width * clustersize, height * clustersize,
+			  st->display_offsetX + x * clustersize,
+			  st->display_offsetY + y * clustersize);
+	}
+}
+
+
+/*
+ * life_display_redraw() - Draw every cell on the display from scratch.
+ *
+ *	Used after the display has moved to another part of the universe.
+ *	Trails are lost.
+ */
+void
+life_display_redraw(struct state *st, Display *dpy, Window window)
+{
+	struct life_state *life = &st->life;
+	struct cell_cluster_list *lists[2] = { &life->active, &life->idle };
+	struct cell_cluster *cluster;
+	int xoffset, yoffset;
+	int viewX, viewY;
+	int i;
+
+	int clustersize = st->cellsize * CLUSTERSIZE;
+
+	if (st->ximage != NULL)
+		life_image_fill(st, 0, 0, st->xgwa.width, st->xgwa.height,
+				st->bgpixel);
+	else
+		XFillRectangle(dpy, st->buf, st->gc_erase, 0, 0,
+			       st->xgwa.width, st->xgwa.height);
+	st->damageall = True;
+
+	for (i = 0; i < 2; i++) {
+		TAILQ_FOREACH(cluster, lists[i], link) {
+			if (!life_cluster_visible(life, cluster->clusterX,
+						  cluster->clusterY,
+						  &viewX, &viewY))
+				continue;
+
+			xoffset = st->display_offsetX + viewX * clustersize;
+			yoffset = st->display_offsetY + viewY * clustersize;
+			life_cluster_draw(st, dpy, window, cluster,
+					  xoffset, yoffset, True);
+		}
+	}
+}
+
+
+/*
+ * life_display_flush() - Draw the cells queued by life_cell_draw().
+ */
+void
+life_display_flush(struct state *st, Display *dpy)
+{
+	struct life_fillbucket *bucket;
+	GC context;
+	int i;
+
+	if (st->ximage != NULL) {
+		if (st->dirtyX1 >= st->dirtyX2)
+			return;
+#ifdef HAVE_XSHM_EXTENSION
+		if (st->use_shm)
+			XShmPutImage(dpy, st->buf, st->gc_draw, st->ximage,
+				     st->dirtyX1, st->dirtyY1,
+				     st->dirtyX1, st->dirtyY1,
+				     st->dirtyX2 - st->dirtyX1,
+				     st->dirtyY2 - st->dirtyY1, False);
+		else
+#endif
+		XPutImage(dpy, st->buf, st->gc_draw, st->ximage,
+			  st->dirtyX1, st->dirtyY1, st->dirtyX1, st->dirtyY1,
+			  st->dirtyX2 - st->dirtyX1,
+			  st->dirtyY2 - st->dirtyY1);
+		st->dirtyX1 = st->dirtyX2 = 0;
+		return;
+	}
+
+	for (i = 0; i < st->numbuckets; i++) {
+		bucket = &st->buckets[i];
+		if (bucket->numrects == 0)
+			continue;
+
+		context = st->gc_draw;
+		if (i < st->numcolors) {
+			XSetForeground(dpy, st->gc_draw,
+				       st->colors[i + CELL_MINALIVE].pixel);
+		} else if (i < st->numcolors * 2) {
+			XSetForeground(dpy, st->gc_draw,
+			    st->trailcolors[i - st->numcolors +
+					    CELL_MINALIVE].pixel);
+		} else {
+			context = st->gc_erase;
+		}
+		XFillRectangles(dpy, st->buf, context, bucket->rects,
+				bucket->numrects);
+		bucket->numrects = 0;
 	}
 }
 
 
+/*
+ * life_display_pan() - Move the display by the given number of clusters.
+ */
+void
+life_display_pan(struct state *st, int xoffset, int yoffset)
+{
+
+	life_state_pan(&st->life, xoffset, yoffset);
+	st->redraw = True;
+}
+
+
 #ifdef LIFE_SHOWGRID
 static
 void
@@ -1458,13 +1110,13 @@ life_display_grid(const struct state * const st, Display *dpy)
 {
 	int i;
 	int s = CLUSTERSIZE * st->cellsize;
-	for (i = 1; i < st->cluster_numY; i++) {
+	for (i = 1; i < st->life.cluster_numY; i++) {
 		int pos = (i * s) + st->display_offsetY - 1;
 		XDrawLine(dpy, st->buf, st->gc_draw,
 			  st->display_offsetX, pos,
 			  st->xgwa.width - st->display_offsetX, pos);
 	}
-	for (i = 1; i < st->cluster_numX; i++) {
+	for (i = 1; i < st->life.cluster_numX; i++) {
 		int pos = (i * s) + st->display_offsetY - 1;
 		XDrawLine(dpy, st->buf, st->gc_draw,
 			  pos, st->display_offsetY,
@@ -1486,10 +1138,23 @@ const char *life_hack_defaults [] = {
 	"*cellBorder:		True",
 	"*trails:		True",
 	"*doubleBuffer:		True",
+	"*kernel:		swar",
+	"*threads:		1",
+	"*universeScale:	1",
+	"*gensPerFrame:		1",
+	"*dropFrames:		True",
+	"*renderer:		fill",
+	"*engine:		clusters",
+	"*hashStep:		0",
+	"*warmup:		0",
+	"*statsInterval:	0",
 #ifdef HAVE_DOUBLE_BUFFER_EXTENSION
 	"*useDBE:		True",
 	"*useDBEClear:		True",
 #endif /* HAVE_DOUBLE_BUFFER_EXTENSION */
+#ifdef HAVE_XSHM_EXTENSION
+	"*useSHM:		True",
+#endif /* HAVE_XSHM_EXTENSION */
 	NULL
 };
 
@@ -1505,6 +1170,22 @@ const XrmOptionDescRec life_hack_options [] = {
 	{ "-db",		".doubleBuffer", XrmoptionNoArg, "True" },
 	{ "-no-db",		".doubleBuffer", XrmoptionNoArg, "False" },
 	{ "-patterns",		".patternPath", XrmoptionSepArg, NULL },
+	{ "-kernel",		".kernel",	XrmoptionSepArg, NULL },
+	{ "-threads",		".threads",	XrmoptionSepArg, NULL },
+	{ "-universescale",	".universeScale", XrmoptionSepArg, NULL },
+	{ "-gensperframe",	".gensPerFrame", XrmoptionSepArg, NULL },
+	{ "-dropframes",	".dropFrames",	XrmoptionNoArg, "True" },
+	{ "-no-dropframes",	".dropFrames",	XrmoptionNoArg, "False" },
+	{ "-renderer",		".renderer",	XrmoptionSepArg, NULL },
+#ifdef HAVE_XSHM_EXTENSION
+	{ "-shm",		".useSHM",	XrmoptionNoArg, "True" },
+	{ "-no-shm",		".useSHM",	XrmoptionNoArg, "False" },
+#endif /* HAVE_XSHM_EXTENSION */
+	{ "-engine",		".engine",	XrmoptionSepArg, NULL },
+	{ "-hashstep",		".hashStep",	XrmoptionSepArg, NULL },
+	{ "-warmup",		".warmup",	XrmoptionSepArg, NULL },
+	{ "-stats",		".statsInterval", XrmoptionSepArg, NULL },
+	{ "-snapshot",		".snapshotFile", XrmoptionSepArg, NULL },
 	{ 0, 0, 0, 0 }
 };
 
@@ -1515,8 +1196,7 @@ life_hack_init(Display *dpy, Window window)
 	struct state *st = (struct state *)calloc(1, sizeof(*st));
 
 	life_display_init(st, dpy, window);
-	life_state_init(st, dpy);
-	life_pattern_init(st, dpy);
+	life_state_setup(st, dpy);
 
 #ifdef LIFE_SHOWGRID
 	life_display_grid(st, dpy);
@@ -1525,15 +1205,187 @@ life_hack_init(Display *dpy, Window window)
 }
 
 
+/*
+ * life_stats_cmp() - Compare frame times for qsort().
+ */
+static
+int
+life_stats_cmp(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+
+/*
+ * life_stats_report() - Print the statistics for an interval.
+ *
+ *	Frame times are in milliseconds, as are the times spent on each
+ *	phase of a frame on average.  Adding patterns is part of computing.
+ *	The X requests are those issued by the client; the server may take
+ *	its time carrying them out.
+ */
+static
+void
+life_stats_report(struct state *st, int64_t now)
+{
+	struct life_stats *stats = &st->stats;
+	const struct life_counters *c = &st->life.counters;
+	const struct life_counters *c0 = &stats->counters;
+	int64_t total;
+	double gens, frames;
+	int i;
+
+	frames = stats->numframes;
+	total = 0;
+	for (i = 0; i < stats->numframes; i++)
+		total += stats->frametimes[i];
+	qsort(stats->frametimes, stats->numframes,
+	      sizeof(*stats->frametimes), life_stats_cmp);
+	i = (stats->numframes * 99 + 99) / 100 - 1;
+
+	fprintf(stderr, "%s: %.1f sec, %d frames (%u missed, %u dropped); "
+		"frame min/avg/p99/max %.2f/%.2f/%.2f/%.2f ms\n",
+		progname, (now - stats->start) / 1e6, stats->numframes,
+		st->missed - stats->missed, st->dropped - stats->dropped,
+		stats->frametimes[0] / 1e3, total / frames / 1e3,
+		stats->frametimes[i] / 1e3,
+		stats->frametimes[stats->numframes - 1] / 1e3);
+	fprintf(stderr, "%s:   per frame: compute %.2f ms (patterns %.2f), "
+		"draw %.2f ms, present %.2f ms, %.1f X requests\n",
+		progname, stats->updatetime / frames / 1e3,
+		(c->patterntime - c0->patterntime) / frames / 1e3,
+		stats->drawtime / frames / 1e3,
+		stats->presenttime / frames / 1e3,
+		stats->requests / frames);
+
+	gens = c->generations - c0->generations;
+	fprintf(stderr, "%s:   %.0f generations: %llu births, "
+		"%llu deaths; %.1f active, %.1f dormant clusters on "
+		"average\n",
+		progname, gens,
+		(unsigned long long)(c->births - c0->births),
+		(unsigned long long)(c->deaths - c0->deaths),
+		(c->updated - c0->updated) / (gens > 0 ? gens : 1),
+		((c->clusters - c0->clusters) -
+		 (c->updated - c0->updated)) / (gens > 0 ? gens : 1));
+	fprintf(stderr, "%s:   clusters: %llu created, %llu deleted, "
+		"%llu woken; %llu patterns added\n",
+		progname, (unsigned long long)(c->created - c0->created),
+		(unsigned long long)(c->deleted - c0->deleted),
+		(unsigned long long)(c->woken - c0->woken),
+		(unsigned long long)(c->patterns - c0->patterns));
+}
+
+
+/*
+ * life_stats_frame() - Account for a frame.
+ *
+ *	Times are in microseconds; requests is the number of X requests the
+ *	frame issued.  Prints a report once an interval has passed.
+ */
+static
+void
+life_stats_frame(struct state *st, int64_t now, int64_t frametime,
+		 int64_t updatetime, int64_t drawtime, int64_t presenttime,
+		 unsigned long requests)
+{
+	struct life_stats *stats = &st->stats;
+
+	if (stats->start == 0)
+		stats->start = now - frametime;
+	if (stats->numframes == stats->maxframes) {
+		stats->maxframes = stats->maxframes * 2 + 256;
+		stats->frametimes = realloc(stats->frametimes,
+		    stats->maxframes * sizeof(*stats->frametimes));
+		if (stats->frametimes == NULL)
+			exit(1);
+	}
+	stats->frametimes[stats->numframes++] = frametime;
+	stats->updatetime += updatetime;
+	stats->drawtime += drawtime;
+	stats->presenttime += presenttime;
+	stats->requests += requests;
+
+	if (now - stats->start < stats->interval)
+		return;
+	life_stats_report(st, now);
+
+	/* Start the next interval. */
+	stats->start = now;
+	stats->counters = st->life.counters;
+	stats->missed = st->missed;
+	stats->dropped = st->dropped;
+	stats->updatetime = stats->drawtime = stats->presenttime = 0;
+	stats->requests = 0;
+	stats->numframes = 0;
+}
+
+
+/*
+ * life_hack_draw() - Draw a frame and compute the next one.
+ *
+ *	Frames are paced to start every delay microseconds: the time spent
+ *	on a frame is subtracted from the delay before the next one.  If a
+ *	frame starts one or more periods late, the generations of up to
+ *	maxcatchup missed frames are computed without drawing them, so the
+ *	universe keeps evolving at the intended rate; if it is even further
+ *	behind, the schedule starts over.
+ */
 static
 unsigned long
 life_hack_draw(Display *dpy, Window window, void *closure)
 {
 	struct state *st = (struct state *)closure;
+	int64_t start, drawn, presented, computed, now;
+	int64_t late, remaining;
+	unsigned long request;
+	int skip;
+	int i;
 
+	start = life_time();
+	request = NextRequest(dpy);
+	if (st->nextframe == 0 || st->delay == 0)
+		st->nextframe = start;
+
+	skip = 0;
+	late = start - st->nextframe;
+	if (st->delay != 0 && late >= st->delay) {
+		skip = late / st->delay;
+		if (skip > st->maxcatchup) {
+			/* Hopelessly behind; don't try to catch up. */
+			skip = st->maxcatchup;
+			st->nextframe = start - (int64_t)skip * st->delay;
+		}
+		st->dropped += skip;
+	}
+
+	for (i = 0; i < skip * st->gensperframe; i++)
+		life_state_update(&st->life);
+	computed = life_time();
 	life_display_update(st, dpy, window);
-	life_state_update(st);
-	return st->delay;
+	drawn = life_time();
+	life_display_swap(st, dpy, window);
+	presented = life_time();
+	for (i = 0; i < st->gensperframe; i++)
+		life_state_update(&st->life);
+
+	st->nextframe += (int64_t)(skip + 1) * st->delay;
+	now = life_time();
+	remaining = st->nextframe - now;
+	if (remaining < 0) {
+		if (st->delay != 0)
+			st->missed++;
+		remaining = 0;
+	}
+
+	if (st->stats.interval != 0)
+		life_stats_frame(st, now, now - start,
+				 (computed - start) + (now - presented),
+				 drawn - computed, presented - drawn,
+				 NextRequest(dpy) - request);
+	return (remaining);
 }
 
 
@@ -1543,9 +1395,38 @@ life_hack_reshape(Display *dpy, Window window, void *closure,
 		  unsigned int w, unsigned int h)
 {
 	struct state *st = (struct state *)closure;
+	int oldwidth, oldheight;
+	int cell_numX, cell_numY;
 
+	oldwidth = st->xgwa.width;
+	oldheight = st->xgwa.height;
 	XGetWindowAttributes(dpy, window, &st->xgwa);
-	/* XXX Need to recalculate clusters/cells. */
+	if (st->xgwa.width == oldwidth && st->xgwa.height == oldheight)
+		return;
+
+	/*
+	 * Buffers the size of the window are made anew; a DBE back buffer
+	 * follows the window by itself.
+	 */
+	if (st->pixmap != None) {
+		XFreePixmap(dpy, st->pixmap);
+		st->pixmap = XCreatePixmap(dpy, window, st->xgwa.width,
+					   st->xgwa.height, st->xgwa.depth);
+		st->buf = st->pixmap;
+	}
+	if (st->ximage != NULL) {
+		life_image_free(st, dpy);
+		life_image_init(st, dpy, window);
+	}
+
+	/*
+	 * The cells already there carry on in the resized view, which is
+	 * drawn from scratch next frame.
+	 */
+	life_display_cells(st, dpy, &cell_numX, &cell_numY);
+	life_state_resize(&st->life, cell_numX, cell_numY);
+	life_display_layout(st);
+	st->redraw = True;
 }
 
 
@@ -1553,7 +1434,32 @@ static
 Bool
 life_hack_event(Display *dpy, Window window, void *closure, XEvent *event)
 {
-	return False;
+	struct state *st = (struct state *)closure;
+	int stepX, stepY;
+
+	/* The arrow keys move the display a quarter screen at a time. */
+	if (event->xany.type != KeyPress || st->life.hashlife != NULL)
+		return False;
+
+	stepX = (st->life.cluster_numX + 3) / 4;
+	stepY = (st->life.cluster_numY + 3) / 4;
+	switch (XLookupKeysym(&event->xkey, 0)) {
+	case XK_Left:
+		life_display_pan(st, -stepX, 0);
+		break;
+	case XK_Right:
+		life_display_pan(st, stepX, 0);
+		break;
+	case XK_Up:
+		life_display_pan(st, 0, -stepY);
+		break;
+	case XK_Down:
+		life_display_pan(st, 0, stepY);
+		break;
+	default:
+		return False;
+	}
+	return True;
 }
 
 
@@ -1563,9 +1469,14 @@ life_hack_free(Display *dpy, Window window, void *closure)
 {
 	struct state *st = (struct state *)closure;
 
-	life_pattern_free(st);
-	life_state_free(st);
+	if (st->snapshot != NULL &&
+	    !life_state_save(&st->life, st->snapshot))
+		fprintf(stderr, "%s: can't save %s\n", progname, st->snapshot);
+	free(st->snapshot);
+	life_pattern_free(&st->life);
+	life_state_free(&st->life);
 	life_display_free(st, dpy);
+	free(st->stats.frametimes);
 	free(st);
 }
 
@@ -0,0 +1,520 @@
+/*
+ * Copyright (c) 2003,2007 Kelly Yancey (kbyanc@posi.net)
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+/*
+ * Benchmarks for clife.  Runs the simulation on a fixed set of workloads,
+ * one after another, and reports for each the generations per second, the
+ * time spent per active cluster updated, the peak number of clusters and
+ * the peak resident set size, as CSV or JSON.
+ *
+ * Every workload starts from the same seed, so runs do the same work each
+ * time and can be compared across commits and machines; the number of
+ * cells left at the end tells whether they did.  Each workload runs in a
+ * child process of its own so that its resident set size is not inflated
+ * by the workloads before it.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "yarandom.h"
+#include "clife_sim.h"
+
+
+enum workload_kind {
+	WORKLOAD_SOUP,		/* Random cells all over the view. */
+	WORKLOAD_PATTERN,	/* One pattern in the middle of the view. */
+	WORKLOAD_FIELD,		/* Gliders all over the view. */
+	WORKLOAD_LIBRARY,	/* Patterns read from files, all over. */
+	WORKLOAD_SCREENSAVER	/* Patterns added as the screensaver does. */
+};
+
+struct workload {
+	const char *name;
+	enum workload_kind kind;
+	int	 arg;		/* Soup density in percent, or pattern. */
+	int	 scale;		/* Universe size in views, or 0. */
+	int	 numgens;	/* Default number of generations. */
+};
+
+/*
+ * Methuselahs, which take a long time to settle down from a few cells.
+ * The builtin patterns follow them; see life_bench_pattern().
+ */
+static struct coords methuselah_coords[] = {
+#define	METHUSELAH_RPENTOMINO	(methuselah_coords + 0)
+		  { 1, 0 }, { 2, 0 },
+	{ 0, 1 }, { 1, 1 },
+		  { 1, 2 },
+
+#define	METHUSELAH_ACORN	(methuselah_coords + 5)
+		  { 1, 0 },
+				    { 3, 1 },
+	{ 0, 2 }, { 1, 2 },			  { 4, 2 }, { 5, 2 }, { 6, 2 },
+
+	/* Offset 12: End-of-List */
+};
+
+#define	NUMMETHUSELAHS	2
+static const struct pattern methuselahs[NUMMETHUSELAHS] = {
+	{  3,  3,  5, METHUSELAH_RPENTOMINO },
+	{  7,  3,  7, METHUSELAH_ACORN }
+};
+
+/*
+ * The workloads, in the order they are run.  Methuselahs and the builtin
+ * patterns run in an unbounded universe so nothing they throw off comes
+ * back around to hit them; they run for as long as they take to settle.
+ */
+static const struct workload workloads[] = {
+	{ "soup-15",		WORKLOAD_SOUP,		15, 1, 1000 },
+	{ "soup-30",		WORKLOAD_SOUP,		30, 1, 1000 },
+	{ "soup-50",		WORKLOAD_SOUP,		50, 1, 1000 },
+	{ "rpentomino",		WORKLOAD_PATTERN,	0, 0, 1103 },
+	{ "acorn",		WORKLOAD_PATTERN,	1, 0, 5206 },
+	{ "glider-field",	WORKLOAD_FIELD,		0, 1, 1000 },
+	{ "glider",		WORKLOAD_PATTERN,	2, 0, 1000 },
+	{ "bheptomino",		WORKLOAD_PATTERN,	3, 0, 1000 },
+	{ "rabbits",		WORKLOAD_PATTERN,	4, 0, 17331 },
+	{ "library",		WORKLOAD_LIBRARY,	0, 1, 1000 },
+	{ "screensaver",	WORKLOAD_SCREENSAVER,	0, 1, 1000 }
+};
+#define	NUMWORKLOADS	(sizeof(workloads) / sizeof(workloads[0]))
+
+struct bench {
+	struct life_state life;
+	struct life_params params;
+	const char *library;	/* Directory of pattern files. */
+	unsigned int seed;
+	int	 width;		/* Size of the view in cells. */
+	int	 height;
+	int	 numgens;	/* Or 0 for each workload's default. */
+	int	 json;
+};
+
+static const char *progname = "clife-bench";
+
+
+static
+void
+usage(void)
+{
+
+	fprintf(stderr,
+	    "usage: %s [-width cells] [-height cells] [-seed number]\n"
+	    "\t[-gens number] [-kernel name] [-engine name] [-threads number]\n"
+	    "\t[-library directory] [-json] [workload ...]\n", progname);
+	exit(1);
+}
+
+
+/*
+ * life_bench_place() - Add a pattern with its top left corner at x, y.
+ */
+static
+void
+life_bench_place(struct life_state *st, const struct pattern *pattern,
+		 int x, int y, int color)
+{
+	const struct coords *coord, *endcoord;
+
+	endcoord = pattern->coords + pattern->numcoords;
+	for (coord = pattern->coords; coord < endcoord; coord++)
+		life_cell_set(st, x + coord->x, y + coord->y, color);
+}
+
+
+/*
+ * life_bench_pattern() - Look up a pattern by number.
+ *
+ *	Methuselahs come first, followed by the builtin patterns.
+ */
+static
+const struct pattern *
+life_bench_pattern(const struct life_state * const st, int num)
+{
+
+	if (num < NUMMETHUSELAHS)
+		return (&methuselahs[num]);
+	return (&st->patterns[num - NUMMETHUSELAHS]);
+}
+
+
+/*
+ * life_bench_namecmp() - Compare file names for qsort().
+ */
+static
+int
+life_bench_namecmp(const void *a, const void *b)
+{
+
+	return (strcmp(*(char * const *)a, *(char * const *)b));
+}
+
+
+/*
+ * life_bench_library() - Tile the view with patterns from a directory.
+ *
+ *	Every pattern file in the directory (.lif, .rle, .cells or .mc) is
+ *	read through life_pattern_read(), in order of name so that the result
+ *	does not depend on the order readdir() returns them in.  The view is
+ *	then divided into squares big enough for the largest pattern, with
+ *	room to spare, and each square gets the next pattern in turn.  Returns
+ *	the number of patterns read.
+ */
+static
+int
+life_bench_library(struct bench *b)
+{
+	struct life_state * const life = &b->life;
+	struct pattern *patterns;
+	struct dirent *entry;
+	DIR *dir;
+	char **names;
+	char *filename;
+	const char *suffix;
+	size_t len;
+	int numnames, maxnames, numpatterns;
+	int size, x, y, i;
+
+	dir = opendir(b->library);
+	if (dir == NULL) {
+		perror(b->library);
+		return (0);
+	}
+
+	numnames = 0;
+	maxnames = 16;
+	names = malloc(maxnames * sizeof(*names));
+	if (names == NULL)
+		exit(1);
+	while ((entry = readdir(dir)) != NULL) {
+		suffix = strrchr(entry->d_name, '.');
+		if (suffix == NULL || (strcmp(suffix, ".lif") != 0 &&
+		    strcmp(suffix, ".rle") != 0 &&
+		    strcmp(suffix, ".cells") != 0 &&
+		    strcmp(suffix, ".mc") != 0))
+			continue;
+		if (numnames == maxnames) {
+			maxnames *= 2;
+			names = realloc(names, maxnames * sizeof(*names));
+			if (names == NULL)
+				exit(1);
+		}
+		names[numnames] = strdup(entry->d_name);
+		if (names[numnames] == NULL)
+			exit(1);
+		numnames++;
+	}
+	closedir(dir);
+	qsort(names, numnames, sizeof(*names), life_bench_namecmp);
+
+	patterns = calloc(numnames + 1, sizeof(*patterns));
+	if (patterns == NULL)
+		exit(1);
+	numpatterns = 0;
+	size = 0;
+	for (i = 0; i < numnames; i++) {
+		len = strlen(b->library) + 1 + strlen(names[i]) + 1;
+		filename = malloc(len);
+		if (filename == NULL)
+			exit(1);
+		snprintf(filename, len, "%s/%s", b->library, names[i]);
+		if (life_pattern_read(life, filename,
+				      &patterns[numpatterns])) {
+			/* Pattern widths and heights are 1 less. */
+			if ((int)patterns[numpatterns].width >= size)
+				size = patterns[numpatterns].width + 1;
+			if ((int)patterns[numpatterns].height >= size)
+				size = patterns[numpatterns].height + 1;
+			numpatterns++;
+		} else {
+			fprintf(stderr, "%s: can't use %s\n", progname,
+				filename);
+		}
+		free(filename);
+		free(names[i]);
+	}
+	free(names);
+
+	/* Leave as much room between patterns as they take up. */
+	size *= 2;
+	i = 0;
+	for (y = 0; numpatterns > 0 && y + size <= life->cell_numY;
+	     y += size) {
+		for (x = 0; x + size <= life->cell_numX; x += size) {
+			life_bench_place(life, &patterns[i % numpatterns],
+					 x + size / 4, y + size / 4, i);
+			i++;
+		}
+	}
+
+	for (i = 0; i < numpatterns; i++)
+		free(patterns[i].coords);
+	free(patterns);
+	return (numpatterns);
+}
+
+
+/*
+ * life_bench_setup() - Set up the universe for a workload.
+ *
+ *	Returns boolean false if there is nothing to run.
+ */
+static
+int
+life_bench_setup(struct bench *b, const struct workload *w)
+{
+	struct life_state * const life = &b->life;
+	const struct pattern *pattern;
+	int x, y;
+
+	b->params.scale = w->scale;
+	b->params.nofill = w->kind != WORKLOAD_SCREENSAVER;
+	life_state_init(life, &b->params);
+	life_pattern_init(life, NULL, False);
+
+	switch (w->kind) {
+	case WORKLOAD_SOUP:
+		for (y = 0; y < life->cell_numY; y++) {
+			for (x = 0; x < life->cell_numX; x++) {
+				if (random() % 100 < w->arg)
+					life_cell_set(life, x, y, random() %
+						      life->numcolors);
+			}
+		}
+		break;
+
+	case WORKLOAD_PATTERN:
+		pattern = life_bench_pattern(life, w->arg);
+		life_bench_place(life, pattern,
+				 (life->cell_numX - pattern->width) / 2,
+				 (life->cell_numY - pattern->height) / 2, 0);
+		break;
+
+	case WORKLOAD_FIELD:
+		/*
+		 * Gliders 8 cells apart all head the same way, so they never
+		 * collide; each crosses a cluster boundary every few
+		 * generations.
+		 */
+		pattern = &life->patterns[0];
+		for (y = 0; y + 8 <= life->cell_numY; y += 8) {
+			for (x = 0; x + 8 <= life->cell_numX; x += 8)
+				life_bench_place(life, pattern, x + 2, y + 2,
+						 x + y);
+		}
+		break;
+
+	case WORKLOAD_LIBRARY:
+		return (life_bench_library(b) > 0);
+
+	case WORKLOAD_SCREENSAVER:
+		/* life_state_update() adds the patterns. */
+		break;
+	}
+	return (True);
+}
+
+
+/*
+ * life_bench_run() - Run a workload and print its results.
+ *
+ *	Meant to be called in a child process of its own, as the resident
+ *	set size reported is the peak for the whole process.  first is set
+ *	for the first workload printed, for the JSON separators.
+ */
+static
+void
+life_bench_run(struct bench *b, const struct workload *w, int first)
+{
+	struct life_state * const life = &b->life;
+	struct rusage usage;
+	const char *kernel, *engine;
+	int64_t start, elapsed;
+	double seconds, gens, nsper;
+	uint64_t updated;
+	int numgens, peakclusters;
+	int gen;
+
+	/* A seed of 0 picks one from the time and process ID. */
+	ya_rand_init(b->seed);
+
+	if (!life_bench_setup(b, w)) {
+		fprintf(stderr, "%s: nothing to run for %s\n", progname,
+			w->name);
+		exit(1);
+	}
+
+	numgens = b->numgens > 0 ? b->numgens : w->numgens;
+	peakclusters = life->numclusters;
+	start = life_time();
+	for (gen = 0; gen < numgens; gen++) {
+		life_state_update(life);
+		if (life->numclusters > peakclusters)
+			peakclusters = life->numclusters;
+	}
+	elapsed = life_time() - start;
+
+	/* Each hashlife update advances 2^hashStep generations. */
+	gens = life->counters.generations;
+	updated = life->counters.updated;
+	seconds = elapsed / 1e6;
+	nsper = updated > 0 ? elapsed * 1e3 / updated : 0.0;
+
+	/* ru_maxrss is in kilobytes, except on Darwin where it is bytes. */
+	getrusage(RUSAGE_SELF, &usage);
+
+	kernel = b->params.kernel != NULL ? b->params.kernel : "swar";
+	engine = b->params.engine != NULL ? b->params.engine : "clusters";
+	if (b->json) {
+		printf("%s  { \"workload\": \"%s\", \"engine\": \"%s\", "
+		       "\"kernel\": \"%s\",\n"
+		       "    \"clustersize\": %d, \"threads\": %d, "
+		       "\"seed\": %u, \"width\": %d, \"height\": %d,\n"
+		       "    \"generations\": %.0f, \"seconds\": %.6f, "
+		       "\"gens_per_sec\": %.1f,\n"
+		       "    \"ns_per_cluster\": %.1f, "
+		       "\"peak_clusters\": %d, \"cells\": %d, "
+		       "\"maxrss\": %ld }",
+		       first ? "" : ",\n", w->name, engine, kernel,
+		       CLUSTERSIZE, life->numthreads, b->seed,
+		       life->cell_numX, life->cell_numY, gens, seconds,
+		       seconds > 0 ? gens / seconds : 0.0, nsper,
+		       peakclusters, life->numcells, (long)usage.ru_maxrss);
+	} else {
+		printf("%s,%s,%s,%d,%d,%u,%d,%d,%.0f,%.6f,%.1f,%.1f,%d,%d,"
+		       "%ld\n",
+		       w->name, engine, kernel, CLUSTERSIZE, life->numthreads,
+		       b->seed, life->cell_numX, life->cell_numY, gens,
+		       seconds, seconds > 0 ? gens / seconds : 0.0, nsper,
+		       peakclusters, life->numcells, (long)usage.ru_maxrss);
+	}
+	fflush(stdout);
+
+	life_pattern_free(life);
+	life_state_free(life);
+}
+
+
+int
+main(int argc, char **argv)
+{
+	struct bench b;
+	const struct workload *selected[NUMWORKLOADS];
+	int numselected;
+	int status;
+	int first, failed;
+	pid_t pid;
+	size_t w;
+	int i;
+
+	memset(&b, 0, sizeof(b));
+	b.params.progname = progname;
+	b.params.numcolors = 50;
+	b.params.numthreads = 1;
+	b.params.gensperdraw = 1;
+	b.library = "clife-patterns";
+	b.seed = 1;
+	b.width = 512;
+	b.height = 512;
+
+	numselected = 0;
+	for (i = 1; i < argc; i++) {
+		if (argv[i][0] != '-') {
+			for (w = 0; w < NUMWORKLOADS; w++) {
+				if (strcmp(argv[i], workloads[w].name) == 0)
+					break;
+			}
+			if (w == NUMWORKLOADS || numselected == NUMWORKLOADS)
+				usage();
+			selected[numselected++] = &workloads[w];
+			continue;
+		}
+		if (strcmp(argv[i], "-json") == 0) {
+			b.json = True;
+			continue;
+		}
+		if (i + 1 == argc)
+			usage();
+		if (strcmp(argv[i], "-width") == 0)
+			b.width = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-height") == 0)
+			b.height = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-seed") == 0)
+			b.seed = strtoul(argv[++i], NULL, 0);
+		else if (strcmp(argv[i], "-gens") == 0)
+			b.numgens = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-kernel") == 0)
+			b.params.kernel = argv[++i];
+		else if (strcmp(argv[i], "-engine") == 0)
+			b.params.engine = argv[++i];
+		else if (strcmp(argv[i], "-threads") == 0)
+			b.params.numthreads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-library") == 0)
+			b.library = argv[++i];
+		else
+			usage();
+	}
+	if (b.width < 1 || b.height < 1 || b.numgens < 0)
+		usage();
+	if (numselected == 0) {
+		for (w = 0; w < NUMWORKLOADS; w++)
+			selected[numselected++] = &workloads[w];
+	}
+	b.params.cell_numX = b.width;
+	b.params.cell_numY = b.height;
+
+	if (b.json)
+		printf("[\n");
+	else
+		printf("workload,engine,kernel,clustersize,threads,seed,"
+		       "width,height,generations,seconds,gens_per_sec,"
+		       "ns_per_cluster,peak_clusters,cells,maxrss\n");
+	fflush(stdout);
+
+	first = True;
+	failed = False;
+	for (i = 0; i < numselected; i++) {
+		pid = fork();
+		if (pid == -1) {
+			perror("fork");
+			exit(1);
+		}
+		if (pid == 0) {
+			life_bench_run(&b, selected[i], first);
+			exit(0);
+		}
+		if (waitpid(pid, &status, 0) == -1) {
+			perror("waitpid");
+			exit(1);
+		}
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+			first = False;
+		else
+			failed = True;
+	}
+
+	if (b.json)
+		printf("\n]\n");
+	return (failed);
+}
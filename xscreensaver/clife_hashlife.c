@@ -0,0 +1,788 @@
+/*
+ * Copyright (c) 2003,2007 Kelly Yancey (kbyanc@posi.net)
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+/*
+ * Hashlife, after Gosper: the universe is a quadtree in which identical
+ * subtrees are shared through a hash table, and each node memoizes its
+ * "result", the center half of the node advanced some number of
+ * generations.  Since the same subtrees turn up over and over again in
+ * Life, most results are found in the table rather than computed.
+ *
+ * A node of level k covers 2^k x 2^k cells.  The leaves are level 3 (8x8
+ * cells, stored as a 64-bit map with cell (x, y) at bit y * 8 + x as in
+ * clife's bit-parallel kernel) and the results of level 4 nodes are
+ * computed directly with bitwise operations.  The result of a level k node
+ * is normally 2^(k-2) generations on; when stepping by fewer generations
+ * (2^j for j < k-2) the recursion takes centers instead of advancing at
+ * the upper levels.  Results are only kept for one step size at a time.
+ *
+ * Nodes are allocated in blocks and are only ever freed by the garbage
+ * collector, which keeps the nodes reachable from the root and throws away
+ * everything else, including all memoized results.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include "clife_hashlife.h"
+
+/*
+ * Parameters:
+ *	HL_LEAFLEVEL	- Level of the 8x8 leaves.
+ *	HL_MINLEVEL	- Smallest root; needed to look 3 levels into it.
+ *	HL_MAXLEVEL	- Largest root; coordinates must fit in an int64_t.
+ *	HL_BLOCKNODES	- Number of nodes allocated at once.
+ */
+#define	HL_LEAFLEVEL	3
+#define	HL_MINLEVEL	6
+#define	HL_MAXLEVEL	62
+#define	HL_BLOCKNODES	4096
+
+/* Quadrants, in the same order as clife's directions. */
+#define	HL_NW		0
+#define	HL_NE		1
+#define	HL_SW		2
+#define	HL_SE		3
+
+struct hl_node {
+	union {
+		struct hl_node *child[4];	/* Levels above the leaves. */
+		uint64_t bits;			/* Leaves. */
+	} u;
+	struct hl_node	*result;	/* Memoized result, or NULL. */
+	struct hl_node	*next;		/* Hash chain or free list. */
+	uint64_t	 population;
+	int		 level;
+	int		 mark;		/* Reachable; for garbage collection. */
+};
+
+struct hl_block {
+	struct hl_block	*next;
+	struct hl_node	 nodes[HL_BLOCKNODES];
+};
+
+struct hashlife {
+	struct hl_node	**table;
+	size_t		 tablemask;	/* Table size less 1; a power of 2. */
+	size_t		 numnodes;
+	size_t		 maxnodes;	/* Collect garbage beyond this. */
+	struct hl_block	*blocks;
+	struct hl_node	*freelist;
+
+	struct hl_node	*empty[HL_MAXLEVEL + 1];
+	struct hl_node	*root;
+	int		 resultstep;	/* log2 generations of the results. */
+	uint64_t	 generation;
+};
+
+
+static __inline
+int
+hl_popcount(uint64_t v)
+{
+
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return ((v * 0x0101010101010101ULL) >> 56);
+}
+
+
+static __inline
+size_t
+hl_hash(const struct hl_node *node)
+{
+	uint64_t h;
+
+	if (node->level == HL_LEAFLEVEL)
+		h = node->u.bits;
+	else {
+		h = (uintptr_t)node->u.child[HL_NW];
+		h = h * 0x9e3779b97f4a7c15ULL + (uintptr_t)node->u.child[HL_NE];
+		h = h * 0x9e3779b97f4a7c15ULL + (uintptr_t)node->u.child[HL_SW];
+		h = h * 0x9e3779b97f4a7c15ULL + (uintptr_t)node->u.child[HL_SE];
+	}
+	h ^= h >> 29;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 32;
+	return ((size_t)h);
+}
+
+
+/*
+ * hl_alloc() - Allocate an uninitialized node.
+ */
+static
+struct hl_node *
+hl_alloc(struct hashlife *hl)
+{
+	struct hl_block *block;
+	struct hl_node *node;
+	int i;
+
+	if (hl->freelist == NULL) {
+		block = malloc(sizeof(*block));
+		if (block == NULL)
+			exit(1);
+		block->next = hl->blocks;
+		hl->blocks = block;
+		for (i = HL_BLOCKNODES - 1; i >= 0; i--) {
+			block->nodes[i].next = hl->freelist;
+			hl->freelist = &block->nodes[i];
+		}
+	}
+
+	node = hl->freelist;
+	hl->freelist = node->next;
+	return (node);
+}
+
+
+/*
+ * hl_rehash() - Double the size of the hash table.
+ */
+static
+void
+hl_rehash(struct hashlife *hl)
+{
+	struct hl_node **table;
+	struct hl_node *node, *next;
+	size_t tablemask;
+	size_t i, bucket;
+
+	tablemask = (hl->tablemask << 1) | 1;
+	table = calloc(tablemask + 1, sizeof(*table));
+	if (table == NULL)
+		exit(1);
+
+	for (i = 0; i <= hl->tablemask; i++) {
+		for (node = hl->table[i]; node != NULL; node = next) {
+			next = node->next;
+			bucket = hl_hash(node) & tablemask;
+			node->next = table[bucket];
+			table[bucket] = node;
+		}
+	}
+
+	free(hl->table);
+	hl->table = table;
+	hl->tablemask = tablemask;
+}
+
+
+/*
+ * hl_insert() - Add a new node to the hash table.
+ */
+static
+struct hl_node *
+hl_insert(struct hashlife *hl, const struct hl_node *key, size_t hash)
+{
+	struct hl_node *node;
+	size_t bucket;
+
+	node = hl_alloc(hl);
+	*node = *key;
+	node->result = NULL;
+	node->mark = 0;
+
+	bucket = hash & hl->tablemask;
+	node->next = hl->table[bucket];
+	hl->table[bucket] = node;
+
+	if (++hl->numnodes > hl->tablemask)
+		hl_rehash(hl);
+	return (node);
+}
+
+
+/*
+ * hl_leaf() - Find or create the leaf with the given cells.
+ */
+static
+struct hl_node *
+hl_leaf(struct hashlife *hl, uint64_t bits)
+{
+	struct hl_node key, *node;
+	size_t hash;
+
+	key.u.bits = bits;
+	key.level = HL_LEAFLEVEL;
+	hash = hl_hash(&key);
+
+	for (node = hl->table[hash & hl->tablemask]; node != NULL;
+	     node = node->next) {
+		if (node->level == HL_LEAFLEVEL && node->u.bits == bits)
+			return (node);
+	}
+
+	key.population = hl_popcount(bits);
+	return (hl_insert(hl, &key, hash));
+}
+
+
+/*
+ * hl_node() - Find or create the node with the given quadrants.
+ */
+static
+struct hl_node *
+hl_node(struct hashlife *hl, struct hl_node *nw, struct hl_node *ne,
+	struct hl_node *sw, struct hl_node *se)
+{
+	struct hl_node key, *node;
+	size_t hash;
+
+	key.u.child[HL_NW] = nw;
+	key.u.child[HL_NE] = ne;
+	key.u.child[HL_SW] = sw;
+	key.u.child[HL_SE] = se;
+	key.level = nw->level + 1;
+	hash = hl_hash(&key);
+
+	for (node = hl->table[hash & hl->tablemask]; node != NULL;
+	     node = node->next) {
+		if (node->level == key.level &&
+		    node->u.child[HL_NW] == nw && node->u.child[HL_NE] == ne &&
+		    node->u.child[HL_SW] == sw && node->u.child[HL_SE] == se)
+			return (node);
+	}
+
+	key.population = nw->population + ne->population +
+			 sw->population + se->population;
+	return (hl_insert(hl, &key, hash));
+}
+
+
+/*
+ * hl_empty() - Return the empty node of the given level.
+ */
+static
+struct hl_node *
+hl_empty(struct hashlife *hl, int level)
+{
+	struct hl_node *sub;
+
+	if (hl->empty[level] == NULL) {
+		if (level == HL_LEAFLEVEL)
+			hl->empty[level] = hl_leaf(hl, 0);
+		else {
+			sub = hl_empty(hl, level - 1);
+			hl->empty[level] = hl_node(hl, sub, sub, sub, sub);
+		}
+	}
+	return (hl->empty[level]);
+}
+
+
+/*
+ * hl_rows() - Unpack a level 4 node into 16 rows of 16 cells.
+ * hl_rowsleaf() - Pack the center 8x8 cells of 16 rows into a leaf.
+ */
+static __inline
+void
+hl_rows(const struct hl_node *node, unsigned int rows[16])
+{
+	uint64_t nw, ne, sw, se;
+	int y;
+
+	nw = node->u.child[HL_NW]->u.bits;
+	ne = node->u.child[HL_NE]->u.bits;
+	sw = node->u.child[HL_SW]->u.bits;
+	se = node->u.child[HL_SE]->u.bits;
+	for (y = 0; y < 8; y++) {
+		rows[y] = ((nw >> (y * 8)) & 0xff) |
+			  ((ne >> (y * 8)) & 0xff) << 8;
+		rows[y + 8] = ((sw >> (y * 8)) & 0xff) |
+			      ((se >> (y * 8)) & 0xff) << 8;
+	}
+}
+
+static __inline
+uint64_t
+hl_rowsleaf(const unsigned int rows[16])
+{
+	uint64_t bits;
+	int y;
+
+	bits = 0;
+	for (y = 0; y < 8; y++)
+		bits |= (uint64_t)((rows[y + 4] >> 4) & 0xff) << (y * 8);
+	return (bits);
+}
+
+
+/*
+ * hl_rowstep() - Advance 16 rows of 16 cells by one generation.
+ *
+ *	Cells outside the rows are taken to be dead, so the outermost ring
+ *	becomes wrong each generation; after 4 generations only the center
+ *	8x8 cells are still right, which is all that is needed.  The
+ *	neighbors are counted with the same bit-sliced adder as clife's
+ *	bit-parallel kernel.
+ */
+static
+void
+hl_rowstep(unsigned int rows[16])
+{
+	unsigned int next[16];
+	unsigned int above, below, cur;
+	unsigned int nbr[8];
+	unsigned int sum0, sum1, sum4, carry0;
+	int y, i;
+
+	for (y = 0; y < 16; y++) {
+		above = y > 0 ? rows[y - 1] : 0;
+		below = y < 15 ? rows[y + 1] : 0;
+		cur = rows[y];
+
+		nbr[0] = above << 1;
+		nbr[1] = above;
+		nbr[2] = above >> 1;
+		nbr[3] = cur << 1;
+		nbr[4] = cur >> 1;
+		nbr[5] = below << 1;
+		nbr[6] = below;
+		nbr[7] = below >> 1;
+
+		sum0 = sum1 = sum4 = 0;
+		for (i = 0; i < 8; i++) {
+			carry0 = sum0 & nbr[i];
+			sum0 ^= nbr[i];
+			sum4 |= sum1 & carry0;
+			sum1 ^= carry0;
+		}
+
+		/* Alive with 2 or 3 neighbors, or dead with 3. */
+		next[y] = sum1 & ~sum4 & (sum0 | cur) & 0xffff;
+	}
+	memcpy(rows, next, sizeof(next));
+}
+
+
+/*
+ * hl_center() - Return the center half of a node, one level down.
+ */
+static
+struct hl_node *
+hl_center(struct hashlife *hl, const struct hl_node *node)
+{
+	unsigned int rows[16];
+
+	if (node->level == HL_LEAFLEVEL + 1) {
+		hl_rows(node, rows);
+		return (hl_leaf(hl, hl_rowsleaf(rows)));
+	}
+	return (hl_node(hl, node->u.child[HL_NW]->u.child[HL_SE],
+			    node->u.child[HL_NE]->u.child[HL_SW],
+			    node->u.child[HL_SW]->u.child[HL_NE],
+			    node->u.child[HL_SE]->u.child[HL_NW]));
+}
+
+
+/*
+ * hl_next() - Compute the result of a node.
+ *
+ *	The result is the center half of the node advanced 2^log2gens
+ *	generations, or 2^(level-2) generations if that is fewer.  The node
+ *	is split into 9 overlapping subnodes of half its size whose results
+ *	are combined into 4 overlapping nodes of half its size, which are
+ *	in turn either advanced again or cut down to their centers to give
+ *	the 4 quadrants of the result.
+ */
+static
+struct hl_node *
+hl_next(struct hashlife *hl, struct hl_node *node, int log2gens)
+{
+	struct hl_node *sub[9], *quad[4];
+	struct hl_node *nw, *ne, *sw, *se;
+	unsigned int rows[16];
+	int gens, i;
+
+	if (node->result != NULL)
+		return (node->result);
+
+	if (node->population == 0) {
+		node->result = hl_empty(hl, node->level - 1);
+		return (node->result);
+	}
+
+	if (node->level == HL_LEAFLEVEL + 1) {
+		gens = log2gens < 2 ? 1 << log2gens : 4;
+		hl_rows(node, rows);
+		while (gens-- > 0)
+			hl_rowstep(rows);
+		node->result = hl_leaf(hl, hl_rowsleaf(rows));
+		return (node->result);
+	}
+
+	nw = node->u.child[HL_NW];
+	ne = node->u.child[HL_NE];
+	sw = node->u.child[HL_SW];
+	se = node->u.child[HL_SE];
+
+	sub[0] = nw;
+	sub[1] = hl_node(hl, nw->u.child[HL_NE], ne->u.child[HL_NW],
+			 nw->u.child[HL_SE], ne->u.child[HL_SW]);
+	sub[2] = ne;
+	sub[3] = hl_node(hl, nw->u.child[HL_SW], nw->u.child[HL_SE],
+			 sw->u.child[HL_NW], sw->u.child[HL_NE]);
+	sub[4] = hl_node(hl, nw->u.child[HL_SE], ne->u.child[HL_SW],
+			 sw->u.child[HL_NE], se->u.child[HL_NW]);
+	sub[5] = hl_node(hl, ne->u.child[HL_SW], ne->u.child[HL_SE],
+			 se->u.child[HL_NW], se->u.child[HL_NE]);
+	sub[6] = sw;
+	sub[7] = hl_node(hl, sw->u.child[HL_NE], se->u.child[HL_NW],
+			 sw->u.child[HL_SE], se->u.child[HL_SW]);
+	sub[8] = se;
+
+	for (i = 0; i < 9; i++)
+		sub[i] = hl_next(hl, sub[i], log2gens);
+
+	quad[HL_NW] = hl_node(hl, sub[0], sub[1], sub[3], sub[4]);
+	quad[HL_NE] = hl_node(hl, sub[1], sub[2], sub[4], sub[5]);
+	quad[HL_SW] = hl_node(hl, sub[3], sub[4], sub[6], sub[7]);
+	quad[HL_SE] = hl_node(hl, sub[4], sub[5], sub[7], sub[8]);
+
+	for (i = 0; i < 4; i++) {
+		if (log2gens >= node->level - 2)
+			quad[i] = hl_next(hl, quad[i], log2gens);
+		else
+			quad[i] = hl_center(hl, quad[i]);
+	}
+
+	node->result = hl_node(hl, quad[HL_NW], quad[HL_NE],
+			       quad[HL_SW], quad[HL_SE]);
+	return (node->result);
+}
+
+
+/*
+ * hl_expand() - Double the size of the universe, keeping it centered.
+ */
+static
+void
+hl_expand(struct hashlife *hl)
+{
+	struct hl_node *root = hl->root;
+	struct hl_node *e;
+
+	e = hl_empty(hl, root->level - 1);
+	hl->root = hl_node(hl,
+			   hl_node(hl, e, e, e, root->u.child[HL_NW]),
+			   hl_node(hl, e, e, root->u.child[HL_NE], e),
+			   hl_node(hl, e, root->u.child[HL_SW], e, e),
+			   hl_node(hl, root->u.child[HL_SE], e, e, e));
+}
+
+
+/*
+ * hl_inner() - Check whether all cells are in the center quarter.
+ */
+static
+int
+hl_inner(const struct hl_node *root)
+{
+	struct hl_node * const *c = root->u.child;
+
+	return (root->population ==
+		c[HL_NW]->u.child[HL_SE]->u.child[HL_SE]->population +
+		c[HL_NE]->u.child[HL_SW]->u.child[HL_SW]->population +
+		c[HL_SW]->u.child[HL_NE]->u.child[HL_NE]->population +
+		c[HL_SE]->u.child[HL_NW]->u.child[HL_NW]->population);
+}
+
+
+/*
+ * hl_set() - Return a copy of a node with the given cell set.
+ *
+ *	The coordinates are relative to the node's top-left corner.
+ */
+static
+struct hl_node *
+hl_set(struct hashlife *hl, struct hl_node *node, int64_t x, int64_t y)
+{
+	struct hl_node *child[4];
+	int64_t half;
+	int quadrant;
+
+	if (node->level == HL_LEAFLEVEL)
+		return (hl_leaf(hl, node->u.bits | (uint64_t)1 << (y * 8 + x)));
+
+	half = (int64_t)1 << (node->level - 1);
+	quadrant = (y >= half ? HL_SW : HL_NW) + (x >= half ? 1 : 0);
+	memcpy(child, node->u.child, sizeof(child));
+	child[quadrant] = hl_set(hl, child[quadrant], x & (half - 1),
+				 y & (half - 1));
+	return (hl_node(hl, child[HL_NW], child[HL_NE],
+			child[HL_SW], child[HL_SE]));
+}
+
+
+/*
+ * hl_mark() - Mark a node and everything below it as reachable.
+ */
+static
+void
+hl_mark(struct hl_node *node)
+{
+	int i;
+
+	if (node == NULL || node->mark)
+		return;
+	node->mark = 1;
+	if (node->level > HL_LEAFLEVEL) {
+		for (i = 0; i < 4; i++)
+			hl_mark(node->u.child[i]);
+	}
+}
+
+
+/*
+ * hl_collect() - Free every node not reachable from the root.
+ *
+ *	All memoized results are dropped, as they may refer to freed nodes.
+ *	If most nodes are still in use afterwards, the limit is raised so
+ *	that we do not collect again right away.
+ */
+static
+void
+hl_collect(struct hashlife *hl)
+{
+	struct hl_node **prev, *node;
+	size_t i;
+
+	hl_mark(hl->root);
+	for (i = 0; i <= HL_MAXLEVEL; i++)
+		hl_mark(hl->empty[i]);
+
+	for (i = 0; i <= hl->tablemask; i++) {
+		prev = &hl->table[i];
+		while ((node = *prev) != NULL) {
+			if (node->mark) {
+				node->mark = 0;
+				node->result = NULL;
+				prev = &node->next;
+				continue;
+			}
+			*prev = node->next;
+			node->next = hl->freelist;
+			hl->freelist = node;
+			hl->numnodes--;
+		}
+	}
+
+	if (hl->numnodes > hl->maxnodes / 2)
+		hl->maxnodes *= 2;
+}
+
+
+/*
+ * hl_getcells() - Report the live cells of a node within a rectangle.
+ */
+static
+void
+hl_getcells(const struct hl_node *node, int64_t nodeX, int64_t nodeY,
+	    int64_t x, int64_t y, int64_t width, int64_t height,
+	    hashlife_cellfunc *func, void *arg)
+{
+	uint64_t bits;
+	int64_t size, half;
+	int64_t cellX, cellY;
+	int i;
+
+	if (node->population == 0)
+		return;
+
+	size = (int64_t)1 << node->level;
+	if (nodeX >= x + width || nodeX + size <= x ||
+	    nodeY >= y + height || nodeY + size <= y)
+		return;
+
+	if (node->level == HL_LEAFLEVEL) {
+		for (bits = node->u.bits, i = 0; bits != 0; bits >>= 1, i++) {
+			if (!(bits & 1))
+				continue;
+			cellX = nodeX + (i & 7);
+			cellY = nodeY + (i >> 3);
+			if (cellX >= x && cellX < x + width &&
+			    cellY >= y && cellY < y + height)
+				func(arg, cellX, cellY);
+		}
+		return;
+	}
+
+	half = size / 2;
+	hl_getcells(node->u.child[HL_NW], nodeX, nodeY,
+		    x, y, width, height, func, arg);
+	hl_getcells(node->u.child[HL_NE], nodeX + half, nodeY,
+		    x, y, width, height, func, arg);
+	hl_getcells(node->u.child[HL_SW], nodeX, nodeY + half,
+		    x, y, width, height, func, arg);
+	hl_getcells(node->u.child[HL_SE], nodeX + half, nodeY + half,
+		    x, y, width, height, func, arg);
+}
+
+
+/*
+ * hashlife_new() - Create an empty universe.
+ *
+ *	Garbage is collected once more than maxnodes nodes exist.
+ */
+struct hashlife *
+hashlife_new(size_t maxnodes)
+{
+	struct hashlife *hl;
+
+	hl = calloc(1, sizeof(*hl));
+	if (hl == NULL)
+		exit(1);
+
+	hl->tablemask = 1024 - 1;
+	hl->table = calloc(hl->tablemask + 1, sizeof(*hl->table));
+	if (hl->table == NULL)
+		exit(1);
+	hl->maxnodes = maxnodes;
+	hl->resultstep = -1;
+	hl->root = hl_empty(hl, HL_MINLEVEL);
+	return (hl);
+}
+
+
+void
+hashlife_free(struct hashlife *hl)
+{
+	struct hl_block *block;
+
+	while ((block = hl->blocks) != NULL) {
+		hl->blocks = block->next;
+		free(block);
+	}
+	free(hl->table);
+	free(hl);
+}
+
+
+/*
+ * hashlife_set() - Bring a cell to life.
+ */
+void
+hashlife_set(struct hashlife *hl, int64_t x, int64_t y)
+{
+	int64_t half;
+
+	for (;;) {
+		half = (int64_t)1 << (hl->root->level - 1);
+		if (x >= -half && x < half && y >= -half && y < half)
+			break;
+		if (hl->root->level == HL_MAXLEVEL)
+			return;
+		hl_expand(hl);
+	}
+	hl->root = hl_set(hl, hl->root, x + half, y + half);
+}
+
+
+/*
+ * hashlife_step() - Advance the universe 2^log2gens generations.
+ *
+ *	The universe is first padded until all cells are in the center
+ *	quarter of the root and the root's result is at least 2^log2gens
+ *	generations on; then nothing can escape the result.
+ */
+void
+hashlife_step(struct hashlife *hl, int log2gens)
+{
+	struct hl_node *node;
+	size_t i;
+
+	if (log2gens < 0)
+		log2gens = 0;
+	if (log2gens > HL_MAXLEVEL - 3)
+		log2gens = HL_MAXLEVEL - 3;
+
+	if (hl->numnodes > hl->maxnodes)
+		hl_collect(hl);
+
+	if (log2gens != hl->resultstep) {
+		for (i = 0; i <= hl->tablemask; i++) {
+			for (node = hl->table[i]; node != NULL;
+			     node = node->next)
+				node->result = NULL;
+		}
+		hl->resultstep = log2gens;
+	}
+
+	while (hl->root->level < HL_MINLEVEL ||
+	       hl->root->level < log2gens + 3 || !hl_inner(hl->root)) {
+		if (hl->root->level == HL_MAXLEVEL)
+			break;
+		hl_expand(hl);
+	}
+
+	hl->root = hl_next(hl, hl->root, log2gens);
+	hl->generation += (uint64_t)1 << log2gens;
+}
+
+
+/*
+ * hashlife_crop() - Discard all cells outside the center 2^log2size square.
+ */
+void
+hashlife_crop(struct hashlife *hl, int log2size)
+{
+
+	if (log2size < HL_MINLEVEL)
+		log2size = HL_MINLEVEL;
+	while (hl->root->level > log2size)
+		hl->root = hl_center(hl, hl->root);
+}
+
+
+/*
+ * hashlife_getcells() - Call func for each live cell within a rectangle.
+ */
+void
+hashlife_getcells(const struct hashlife *hl, int64_t x, int64_t y,
+		  int64_t width, int64_t height,
+		  hashlife_cellfunc *func, void *arg)
+{
+	int64_t half;
+
+	half = (int64_t)1 << (hl->root->level - 1);
+	hl_getcells(hl->root, -half, -half, x, y, width, height, func, arg);
+}
+
+
+uint64_t
+hashlife_population(const struct hashlife *hl)
+{
+
+	return (hl->root->population);
+}
+
+
+uint64_t
+hashlife_generation(const struct hashlife *hl)
+{
+
+	return (hl->generation);
+}
+
+
+size_t
+hashlife_numnodes(const struct hashlife *hl)
+{
+
+	return (hl->numnodes);
+}
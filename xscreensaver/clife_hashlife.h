@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2003,2007 Kelly Yancey (kbyanc@posi.net)
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+#ifndef CLIFE_HASHLIFE_H
+#define CLIFE_HASHLIFE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hashlife engine for clife.  The universe is an unbounded plane of
+ * alive/dead cells stored as a memoized quadtree; colors are left to the
+ * caller.  Coordinates are relative to the center of the universe.
+ */
+struct hashlife;
+
+typedef void	hashlife_cellfunc(void *arg, int64_t x, int64_t y);
+
+struct hashlife	*hashlife_new(size_t maxnodes);
+void		 hashlife_free(struct hashlife *hl);
+void		 hashlife_set(struct hashlife *hl, int64_t x, int64_t y);
+void		 hashlife_step(struct hashlife *hl, int log2gens);
+void		 hashlife_crop(struct hashlife *hl, int log2size);
+void		 hashlife_getcells(const struct hashlife *hl,
+				   int64_t x, int64_t y,
+				   int64_t width, int64_t height,
+				   hashlife_cellfunc *func, void *arg);
+uint64_t	 hashlife_population(const struct hashlife *hl);
+uint64_t	 hashlife_generation(const struct hashlife *hl);
+size_t		 hashlife_numnodes(const struct hashlife *hl);
+
+#endif /* !CLIFE_HASHLIFE_H */
@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2003,2007 Kelly Yancey (kbyanc@posi.net)
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+/*
+ * Headless driver for clife.  Runs the simulation as fast as it will go,
+ * without an X server, and reports how long it took; optionally writes the
+ * view out every so many generations as a stream of PPM images or as a
+ * YUV4MPEG2 video, for checking what the simulation did.  The universe can
+ * be started from a snapshot and saved to one at the end.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "yarandom.h"
+#include "clife_sim.h"
+
+
+enum life_format {
+	FORMAT_NONE,
+	FORMAT_PPM,
+	FORMAT_Y4M
+};
+
+struct headless {
+	struct life_state life;
+	int	 cellsize;	/* Size of cells in pixels. */
+	int	 width;		/* Size of frames in pixels. */
+	int	 height;
+	enum life_format format;
+	FILE	*out;
+	unsigned char *palette;	/* RGB by cell color. */
+	unsigned char *frame;	/* RGB, width by height. */
+	unsigned char *planes;	/* Y, Cb and Cr planes, for Y4M. */
+};
+
+static const char *progname = "clife-headless";
+
+
+static
+void
+usage(void)
+{
+
+	fprintf(stderr,
+	    "usage: %s [-width pixels] [-height pixels] [-cellsize pixels]\n"
+	    "\t[-patterns path] [-seed number] [-gens number]\n"
+	    "\t[-kernel name] [-engine name] [-threads number]\n"
+	    "\t[-universescale number] [-maxage number] [-ncolors number]\n"
+	    "\t[-hashstep number] [-warmup number]\n"
+	    "\t[-frames file] [-every number]\n"
+	    "\t[-restore file] [-save file]\n", progname);
+	exit(1);
+}
+
+
+/*
+ * life_palette_init() - Pick an RGB color for each cell color.
+ *
+ *	The same fully saturated hue ramp as the screensaver's, repeated 3
+ *	times; see the note on colors in life_display_init() in clife.c.
+ *	Dead cells are black.
+ */
+static
+void
+life_palette_init(struct headless *hl)
+{
+	const struct life_state * const life = &hl->life;
+	unsigned char *rgb;
+	int hue, sector, rise;
+	int c;
+
+	hl->palette = calloc(life->colorwrap + CELL_MINALIVE, 3);
+	if (hl->palette == NULL)
+		exit(1);
+
+	for (c = CELL_MINALIVE; c < life->colorwrap + CELL_MINALIVE; c++) {
+		/* Hue in 1/256ths of a 60 degree sector. */
+		hue = ((c - CELL_MINALIVE) % life->numcolors) * 6 * 256 /
+		    life->numcolors;
+		sector = hue / 256;
+		rise = hue % 256;
+		rgb = &hl->palette[c * 3];
+		rgb[0] = rgb[1] = rgb[2] = 0;
+		switch (sector) {
+		case 0:		/* Red to yellow. */
+			rgb[0] = 255;
+			rgb[1] = rise;
+			break;
+		case 1:		/* Yellow to green. */
+			rgb[0] = 255 - rise;
+			rgb[1] = 255;
+			break;
+		case 2:		/* Green to cyan. */
+			rgb[1] = 255;
+			rgb[2] = rise;
+			break;
+		case 3:		/* Cyan to blue. */
+			rgb[1] = 255 - rise;
+			rgb[2] = 255;
+			break;
+		case 4:		/* Blue to magenta. */
+			rgb[0] = rise;
+			rgb[2] = 255;
+			break;
+		default:	/* Magenta to red. */
+			rgb[0] = 255;
+			rgb[2] = 255 - rise;
+			break;
+		}
+	}
+}
+
+
+/*
+ * life_frame_cells() - Paint a block of numX by numY cells into the frame.
+ *
+ *	Rows of cells are stride cells apart.  The block goes at cell
+ *	coordinates cellX, cellY of the view.
+ */
+static
+void
+life_frame_cells(struct headless *hl, const cell *cells, int stride,
+		 int numX, int numY, int cellX, int cellY)
+{
+	const unsigned char *rgb;
+	unsigned char *pixel;
+	int x, y, i, j;
+
+	for (y = 0; y < numY; y++) {
+		for (j = 0; j < hl->cellsize; j++) {
+			pixel = hl->frame +
+			    (((cellY + y) * hl->cellsize + j) * hl->width +
+			     cellX * hl->cellsize) * 3;
+			for (x = 0; x < numX; x++) {
+				rgb = &hl->palette[cells[y * stride + x] * 3];
+				for (i = 0; i < hl->cellsize; i++) {
+					*pixel++ = rgb[0];
+					*pixel++ = rgb[1];
+					*pixel++ = rgb[2];
+				}
+			}
+		}
+	}
+}
+
+
+/*
+ * life_frame_write() - Write the view out as a frame.
+ */
+static
+void
+life_frame_write(struct headless *hl)
+{
+	const struct life_state * const life = &hl->life;
+	const struct cell_cluster *cluster;
+	static const cell empty[CLUSTERSIZE][CLUSTERSIZE];
+	const unsigned char *rgb;
+	unsigned char *Y, *Cb, *Cr;
+	int clusterX, clusterY;
+	int viewX, viewY;
+	long i, numpixels;
+
+	if (life->hashlife != NULL) {
+		life_frame_cells(hl, life->hashcells, life->cell_numX,
+				 life->cell_numX, life->cell_numY, 0, 0);
+	} else {
+		for (viewY = 0; viewY < life->cluster_numY; viewY++) {
+			for (viewX = 0; viewX < life->cluster_numX; viewX++) {
+				clusterX = life->view_clusterX + viewX;
+				clusterY = life->view_clusterY + viewY;
+				life_cluster_wrap(life, &clusterX, &clusterY);
+				cluster = life_cluster_lookup(life, clusterX,
+							      clusterY);
+				life_frame_cells(hl, cluster != NULL ?
+				    &LIFE_CURGEN(life, cluster)[0][0] :
+				    &empty[0][0], CLUSTERSIZE,
+				    CLUSTERSIZE, CLUSTERSIZE,
+				    viewX * CLUSTERSIZE, viewY * CLUSTERSIZE);
+			}
+		}
+	}
+
+	numpixels = (long)hl->width * hl->height;
+	if (hl->format == FORMAT_PPM) {
+		fprintf(hl->out, "P6\n%d %d\n255\n", hl->width, hl->height);
+		fwrite(hl->frame, 3, numpixels, hl->out);
+		return;
+	}
+
+	/* Full resolution BT.601 YCbCr, in separate planes. */
+	Y = hl->planes;
+	Cb = Y + numpixels;
+	Cr = Cb + numpixels;
+	for (i = 0, rgb = hl->frame; i < numpixels; i++, rgb += 3) {
+		Y[i] = (66 * rgb[0] + 129 * rgb[1] + 25 * rgb[2] +
+			128 + 4096) >> 8;
+		Cb[i] = (-38 * rgb[0] - 74 * rgb[1] + 112 * rgb[2] +
+			 128 + 32768) >> 8;
+		Cr[i] = (112 * rgb[0] - 94 * rgb[1] - 18 * rgb[2] +
+			 128 + 32768) >> 8;
+	}
+	fputs("FRAME\n", hl->out);
+	fwrite(hl->planes, 3, numpixels, hl->out);
+}
+
+
+/*
+ * life_frames_init() - Open the file frames are written to.
+ *
+ *	Files ending in .y4m get a YUV4MPEG2 stream; anything else, including
+ *	"-" for the standard output, gets one PPM image after another.
+ */
+static
+void
+life_frames_init(struct headless *hl, const char *filename)
+{
+	size_t len;
+
+	hl->width = hl->life.cell_numX * hl->cellsize;
+	hl->height = hl->life.cell_numY * hl->cellsize;
+	hl->frame = malloc((size_t)hl->width * hl->height * 3);
+	if (hl->frame == NULL)
+		exit(1);
+	life_palette_init(hl);
+
+	if (strcmp(filename, "-") == 0) {
+		hl->out = stdout;
+	} else {
+		hl->out = fopen(filename, "wb");
+		if (hl->out == NULL) {
+			perror(filename);
+			exit(1);
+		}
+	}
+
+	len = strlen(filename);
+	hl->format = FORMAT_PPM;
+	if (len > 4 && strcmp(filename + len - 4, ".y4m") == 0) {
+		hl->format = FORMAT_Y4M;
+		hl->planes = malloc((size_t)hl->width * hl->height * 3);
+		if (hl->planes == NULL)
+			exit(1);
+		fprintf(hl->out, "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 C444\n",
+			hl->width, hl->height);
+	}
+}
+
+
+int
+main(int argc, char **argv)
+{
+	struct headless hl;
+	struct life_params params;
+	const char *pattern_path = NULL;
+	const char *frames = NULL;
+	const char *restore = NULL;
+	const char *save = NULL;
+	unsigned int seed = 0;
+	int width = 1024, height = 768;
+	int numgens = 1000;
+	int every = 1;
+	int64_t start, elapsed;
+	int gen;
+	int i;
+
+	memset(&hl, 0, sizeof(hl));
+	memset(&params, 0, sizeof(params));
+	params.progname = progname;
+	params.scale = 1;
+	params.numcolors = 50;
+	params.numthreads = 1;
+	params.gensperdraw = 1;
+	hl.cellsize = 5;
+
+	for (i = 1; i < argc; i++) {
+		if (i + 1 == argc)
+			usage();
+		if (strcmp(argv[i], "-width") == 0)
+			width = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-height") == 0)
+			height = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-cellsize") == 0)
+			hl.cellsize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-patterns") == 0)
+			pattern_path = argv[++i];
+		else if (strcmp(argv[i], "-seed") == 0)
+			seed = strtoul(argv[++i], NULL, 0);
+		else if (strcmp(argv[i], "-gens") == 0)
+			numgens = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-kernel") == 0)
+			params.kernel = argv[++i];
+		else if (strcmp(argv[i], "-engine") == 0)
+			params.engine = argv[++i];
+		else if (strcmp(argv[i], "-threads") == 0)
+			params.numthreads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-universescale") == 0)
+			params.scale = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-maxage") == 0)
+			params.maxage = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-ncolors") == 0)
+			params.numcolors = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-hashstep") == 0)
+			params.hashstep = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-warmup") == 0)
+			params.hashwarmup = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-frames") == 0)
+			frames = argv[++i];
+		else if (strcmp(argv[i], "-every") == 0)
+			every = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-restore") == 0)
+			restore = argv[++i];
+		else if (strcmp(argv[i], "-save") == 0)
+			save = argv[++i];
+		else
+			usage();
+	}
+	if (hl.cellsize < 1 || every < 1 || numgens < 0)
+		usage();
+
+	/* A seed of 0 picks one from the time and process ID. */
+	ya_rand_init(seed);
+
+	params.cell_numX = width / hl.cellsize;
+	params.cell_numY = height / hl.cellsize;
+	life_state_init(&hl.life, &params);
+	/* Load patterns up front, so that runs can be repeated exactly. */
+	life_pattern_init(&hl.life, pattern_path, False);
+	if (restore != NULL && !life_state_restore(&hl.life, restore)) {
+		fprintf(stderr, "%s: can't restore %s\n", progname, restore);
+		exit(1);
+	}
+	if (frames != NULL)
+		life_frames_init(&hl, frames);
+
+	elapsed = 0;
+	for (gen = 0; gen < numgens; gen++) {
+		if (hl.out != NULL && gen % every == 0)
+			life_frame_write(&hl);
+		start = life_time();
+		life_state_update(&hl.life);
+		elapsed += life_time() - start;
+	}
+	if (hl.out != NULL && numgens % every == 0)
+		life_frame_write(&hl);
+
+	/* Keep the standard output clean if frames are written there. */
+	fprintf(hl.out == stdout ? stderr : stdout,
+		"%d updates in %.3f sec, %.1f updates/sec; "
+		"%d cells, %d clusters at the end\n",
+		numgens, elapsed / 1e6,
+		elapsed > 0 ? numgens * 1e6 / elapsed : 0.0,
+		hl.life.numcells, hl.life.numclusters);
+
+	if (save != NULL && !life_state_save(&hl.life, save)) {
+		fprintf(stderr, "%s: can't save %s\n", progname, save);
+		exit(1);
+	}
+	if (hl.out != NULL && hl.out != stdout)
+		fclose(hl.out);
+	free(hl.planes);
+	free(hl.frame);
+	free(hl.palette);
+	life_pattern_free(&hl.life);
+	life_state_free(&hl.life);
+	return (0);
+}
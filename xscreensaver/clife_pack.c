@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2003,2007 Kelly Yancey (kbyanc@posi.net)
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+/*
+ * Pattern pack builder for clife.  Parses pattern files once, in any format
+ * clife reads, and writes them all out as a single pattern pack which clife
+ * maps into memory instead of parsing the files every time it starts; see
+ * the note on packs in clife_sim.h.  Files which are not patterns, or hold
+ * patterns larger than -size cells across, are left out and reported.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "clife_sim.h"
+
+
+static const char *progname = "clife-pack";
+
+
+static
+void
+usage(void)
+{
+
+	fprintf(stderr, "usage: %s [-size cells] -o pack file ...\n",
+		progname);
+	exit(1);
+}
+
+
+static
+void
+pack_write(FILE *f, const char *output, const void *buf, size_t len)
+{
+
+	if (len > 0 && fwrite(buf, len, 1, f) != 1) {
+		fprintf(stderr, "%s: can't write %s\n", progname, output);
+		exit(1);
+	}
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	struct pattern_packheader header;
+	struct pattern_packentry *entries;
+	struct pattern *patterns;
+	struct life_state life;
+	const char *output;
+	unsigned long offset;
+	int numpatterns;
+	int size;
+	int i;
+	FILE *f;
+
+	output = NULL;
+	size = 1024;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (i + 1 == argc)
+			usage();
+		if (strcmp(argv[i], "-size") == 0)
+			size = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0)
+			output = argv[++i];
+		else
+			usage();
+	}
+	if (output == NULL || size < 1 || i == argc)
+		usage();
+
+	/*
+	 * The readers only look at the size of the view, which is twice the
+	 * largest pattern they accept.
+	 */
+	memset(&life, 0, sizeof(life));
+	life.cell_numX = life.cell_numY = size * 2;
+
+	patterns = calloc(argc - i, sizeof(*patterns));
+	entries = calloc(argc - i, sizeof(*entries));
+	if (patterns == NULL || entries == NULL)
+		exit(1);
+	numpatterns = 0;
+	for (; i < argc; i++) {
+		if (life_pattern_read(&life, argv[i], &patterns[numpatterns]))
+			numpatterns++;
+		else
+			fprintf(stderr, "%s: can't use %s\n", progname,
+				argv[i]);
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+	header.byteorder = PACK_BYTEORDER;
+	header.coordsize = sizeof(struct coords);
+	header.numpatterns = numpatterns;
+
+	/* The coordinates follow the index, one pattern after another. */
+	offset = sizeof(header) + numpatterns * sizeof(*entries);
+	for (i = 0; i < numpatterns; i++) {
+		entries[i].width = patterns[i].width;
+		entries[i].height = patterns[i].height;
+		entries[i].numcoords = patterns[i].numcoords;
+		entries[i].offset = offset;
+		offset += patterns[i].numcoords * sizeof(struct coords);
+		if (offset > UINT32_MAX) {
+			fprintf(stderr, "%s: too many patterns for one pack\n",
+				progname);
+			exit(1);
+		}
+	}
+
+	f = fopen(output, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "%s: can't create %s\n", progname, output);
+		exit(1);
+	}
+	pack_write(f, output, &header, sizeof(header));
+	pack_write(f, output, entries, numpatterns * sizeof(*entries));
+	for (i = 0; i < numpatterns; i++) {
+		pack_write(f, output, patterns[i].coords,
+			   patterns[i].numcoords * sizeof(struct coords));
+		free(patterns[i].coords);
+	}
+	if (fclose(f) != 0) {
+		fprintf(stderr, "%s: can't write %s\n", progname, output);
+		exit(1);
+	}
+
+	printf("%d patterns in %s, %lu bytes\n", numpatterns, output, offset);
+	free(entries);
+	free(patterns);
+	return (0);
+}
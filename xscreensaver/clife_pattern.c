@@ -0,0 +1,833 @@
+/*
+ * Copyright (c) 2003,2007 Kelly Yancey (kbyanc@posi.net)
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+/*
+ * Pattern file readers for clife.  A file is read in one pass, a line at a
+ * time into a buffer which grows to fit, and its live cells are collected
+ * into a coordinate array which likewise grows as needed.  The format is
+ * told apart by the first lines of the file:
+ *	Life 1.05	- "#Life 1.05", or "#P" blocks of rows of '*' and '.'.
+ *			  Anything not recognized is read as Life 1.05, as it
+ *			  always has been.
+ *	Life 1.06	- "#Life 1.06", then an "x y" pair per live cell.
+ *	plaintext	- "!" comment lines, then rows of 'O' and '.'.
+ *	RLE		- "#" comment lines, then "x = width, y = height",
+ *			  then run-length encoded rows ending with '!'.
+ *	macrocell	- "[M2]", then a quadtree of 8x8 leaves and the nodes
+ *			  above them, one per line, ending with the root.
+ * There is no limit on the number of cells as such.  Instead, a file is
+ * given up on as soon as its cells span more than the largest pattern which
+ * is placed (half the view each way), so neither huge nor malformed files
+ * cost more than reading as far as that.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "clife_sim.h"
+
+/*
+ * Parameters:
+ *	READER_LINESIZE		- Initial size of the line buffer.
+ *	READER_MAXCOORD		- Numbers in files are clamped to this
+ *				  magnitude, so arithmetic on them cannot
+ *				  overflow.
+ *	MACROCELL_MAXLEVEL	- Largest macrocell node; coordinates must fit
+ *				  in an int64_t.
+ */
+#define	READER_LINESIZE		128
+#define	READER_MAXCOORD		INT_MAX
+#define	MACROCELL_MAXLEVEL	62
+
+struct life_reader {
+	FILE		*f;
+	char		*line;
+	size_t		 linesize;
+
+	struct coords	*coords;	/* Relative to the first cell. */
+	unsigned int	 numcoords;
+	unsigned int	 maxcoords;	/* Allocated. */
+	unsigned long	 limitcoords;	/* Allowed. */
+	int		 limitX;	/* Largest extent allowed, */
+	int		 limitY;	/* less 1. */
+	int64_t		 originX;	/* Of the first cell. */
+	int64_t		 originY;
+	int		 minX, minY;	/* Extent so far, relative to */
+	int		 maxX, maxY;	/* the first cell. */
+};
+
+/*
+ * Macrocell nodes.  Leaves are level 3 (8x8 cells, with cell (x, y) at
+ * bit y * 8 + x); level 1 nodes, used by files with more than 2 states,
+ * are kept the same way.  Node 0 is the empty node, and references to
+ * other empty nodes are replaced with it so that only nodes with live
+ * cells are ever visited.
+ */
+struct life_mcnode {
+	int		 level;
+	int		 leaf;		/* Cells are in bits. */
+	uint64_t	 bits;
+	unsigned int	 child[4];	/* NW, NE, SW, SE. */
+};
+
+#define	MACROCELL_EMPTY(node)						\
+	((node)->bits == 0 && (node)->child[0] == 0 &&			\
+	 (node)->child[1] == 0 && (node)->child[2] == 0 &&		\
+	 (node)->child[3] == 0)
+
+
+static int	 life_reader_line(struct life_reader *rd);
+static int	 life_reader_cell(struct life_reader *rd, int64_t x, int64_t y);
+static int64_t	 life_reader_number(const char *s, char **endptr);
+static int	 life_read_life105(struct life_reader *rd);
+static int	 life_read_life106(struct life_reader *rd);
+static int	 life_read_plaintext(struct life_reader *rd);
+static int	 life_read_rle(struct life_reader *rd);
+static int	 life_read_macrocell(struct life_reader *rd);
+static int	 life_macrocell_cells(struct life_reader *rd,
+				      const struct life_mcnode *nodes,
+				      unsigned int idx, int64_t x, int64_t y);
+
+
+
+/*
+ * life_reader_line() - Read the next line, however long, into rd->line.
+ *
+ *	The line ending, whether "\n" or "\r\n", is dropped.  Returns boolean
+ *	false at the end of the file.
+ */
+static
+int
+life_reader_line(struct life_reader *rd)
+{
+	size_t len;
+	int c;
+
+	len = 0;
+	while ((c = getc(rd->f)) != '\n') {
+		if (c == EOF) {
+			if (len == 0)
+				return (False);
+			break;
+		}
+		if (len + 1 == rd->linesize) {
+			rd->linesize *= 2;
+			rd->line = realloc(rd->line, rd->linesize);
+			if (rd->line == NULL)
+				exit(1);
+		}
+		rd->line[len++] = c;
+	}
+	if (len > 0 && rd->line[len - 1] == '\r')
+		len--;
+	rd->line[len] = '\0';
+	return (True);
+}
+
+
+/*
+ * life_reader_cell() - Add a live cell to the pattern.
+ *
+ *	Returns boolean false if the pattern has grown too large.
+ */
+static
+int
+life_reader_cell(struct life_reader *rd, int64_t x, int64_t y)
+{
+	struct coords *coord;
+
+	if (rd->numcoords == 0) {
+		rd->originX = x;
+		rd->originY = y;
+		rd->minX = rd->minY = rd->maxX = rd->maxY = 0;
+	}
+	x -= rd->originX;
+	y -= rd->originY;
+
+	/* Would the pattern span more than the limit? */
+	if (x < rd->maxX - rd->limitX || x > rd->minX + rd->limitX ||
+	    y < rd->maxY - rd->limitY || y > rd->minY + rd->limitY)
+		return (False);
+	if (x < rd->minX)
+		rd->minX = x;
+	if (x > rd->maxX)
+		rd->maxX = x;
+	if (y < rd->minY)
+		rd->minY = y;
+	if (y > rd->maxY)
+		rd->maxY = y;
+
+	/* Only files listing cells more than once can get here. */
+	if (rd->numcoords == rd->limitcoords)
+		return (False);
+
+	if (rd->numcoords == rd->maxcoords) {
+		rd->maxcoords = rd->maxcoords * 2 + 64;
+		rd->coords = realloc(rd->coords,
+				     rd->maxcoords * sizeof(*rd->coords));
+		if (rd->coords == NULL)
+			exit(1);
+	}
+	coord = &rd->coords[rd->numcoords++];
+	coord->x = x;
+	coord->y = y;
+	return (True);
+}
+
+
+/*
+ * life_reader_number() - Parse a decimal number, clamped to READER_MAXCOORD.
+ */
+static
+int64_t
+life_reader_number(const char *s, char **endptr)
+{
+	long long value;
+
+	value = strtoll(s, endptr, 10);
+	if (value > READER_MAXCOORD)
+		value = READER_MAXCOORD;
+	else if (value < -READER_MAXCOORD)
+		value = -READER_MAXCOORD;
+	return (value);
+}
+
+
+/*
+ * life_read_life105() - Read a Life 1.05 pattern.
+ *
+ *	Rows of '*' (alive) and '.' (dead) follow each "#P x y" line, which
+ *	gives the position of the first.  Other '#' lines are ignored.
+ */
+static
+int
+life_read_life105(struct life_reader *rd)
+{
+	const char *pos;
+	char *endptr;
+	int64_t blockX, x, y;
+
+	blockX = y = 0;
+	do {
+		if (rd->line[0] == '#') {
+			/* We only (barely) understand #P lines. */
+			if (rd->line[1] != 'P')
+				continue;
+			blockX = life_reader_number(rd->line + 2, &endptr);
+			y = life_reader_number(endptr, &endptr);
+			continue;
+		}
+
+		for (pos = rd->line, x = blockX; *pos != '\0'; pos++, x++) {
+			if (*pos == '*' && !life_reader_cell(rd, x, y))
+				return (False);
+		}
+		y++;
+	} while (life_reader_line(rd));
+	return (True);
+}
+
+
+/*
+ * life_read_life106() - Read a Life 1.06 pattern: an "x y" pair per cell.
+ */
+static
+int
+life_read_life106(struct life_reader *rd)
+{
+	char *pos, *endptr;
+	int64_t x, y;
+
+	do {
+		if (rd->line[0] == '#')
+			continue;
+		for (pos = rd->line; isspace((unsigned char)*pos); pos++)
+			continue;
+		if (*pos == '\0')
+			continue;
+
+		x = life_reader_number(pos, &endptr);
+		if (endptr == pos)
+			return (False);
+		pos = endptr;
+		y = life_reader_number(pos, &endptr);
+		if (endptr == pos)
+			return (False);
+		if (!life_reader_cell(rd, x, y))
+			return (False);
+	} while (life_reader_line(rd));
+	return (True);
+}
+
+
+/*
+ * life_read_plaintext() - Read a plaintext (.cells) pattern.
+ *
+ *	Rows of 'O' (alive) and '.' (dead), after '!' comment lines.  '*' is
+ *	taken as alive too.
+ */
+static
+int
+life_read_plaintext(struct life_reader *rd)
+{
+	const char *pos;
+	int64_t x, y;
+
+	y = 0;
+	do {
+		if (rd->line[0] == '!')
+			continue;
+		for (pos = rd->line, x = 0; *pos != '\0'; pos++, x++) {
+			if ((*pos == 'O' || *pos == '*') &&
+			    !life_reader_cell(rd, x, y))
+				return (False);
+		}
+		y++;
+	} while (life_reader_line(rd));
+	return (True);
+}
+
+
+/*
+ * life_read_rle() - Read a run-length encoded pattern.
+ *
+ *	Called with the "x = width, y = height" header line in rd->line.
+ *	Each tag may be preceded by a run count: 'b' or '.' is a dead cell,
+ *	'$' ends a row and '!' the pattern; any other letter is a live cell,
+ *	as is a state of a multi-state rule ('p' to 'y' followed by 'A' to
+ *	'X').  Runs and tags may be split across lines.
+ */
+static
+int
+life_read_rle(struct life_reader *rd)
+{
+	const char *pos;
+	int64_t count, x, y, i;
+
+	count = x = y = 0;
+	while (life_reader_line(rd)) {
+		if (rd->line[0] == '#')
+			continue;
+
+		for (pos = rd->line; *pos != '\0'; pos++) {
+			if (isdigit((unsigned char)*pos)) {
+				count = count * 10 + (*pos - '0');
+				if (count > READER_MAXCOORD)
+					count = READER_MAXCOORD;
+				continue;
+			}
+			if (isspace((unsigned char)*pos))
+				continue;
+			if (count == 0)
+				count = 1;
+
+			switch (*pos) {
+			case '!':
+				return (True);
+
+			case '$':
+				x = 0;
+				y += count;
+				break;
+
+			case 'b':
+			case '.':
+				x += count;
+				break;
+
+			default:
+				if (*pos >= 'p' && *pos <= 'y' &&
+				    pos[1] >= 'A' && pos[1] <= 'X')
+					pos++;
+				else if (!isalpha((unsigned char)*pos))
+					return (False);
+				for (i = 0; i < count; i++) {
+					if (!life_reader_cell(rd, x + i, y))
+						return (False);
+				}
+				x += count;
+				break;
+			}
+			count = 0;
+		}
+	}
+
+	/* Tolerate a missing '!'. */
+	return (True);
+}
+
+
+/*
+ * life_read_macrocell() - Read a 2-state macrocell pattern.
+ *
+ *	Each line after the "[M2]" header defines the next node, numbered
+ *	from 1.  Leaves are given as rows of '*' and '.' ending with '$';
+ *	larger nodes as "level nw ne sw se", the 4 being earlier nodes of the
+ *	level below, or 0 if empty.  The last node is the whole pattern.
+ */
+static
+int
+life_read_macrocell(struct life_reader *rd)
+{
+	struct life_mcnode *nodes, *node;
+	unsigned int numnodes, maxnodes;
+	const char *pos;
+	char *endptr;
+	int64_t value;
+	int x, y;
+	int i;
+	int rv;
+
+	nodes = NULL;
+	numnodes = maxnodes = 0;
+	rv = False;
+
+	do {
+		if (rd->line[0] == '[' || rd->line[0] == '#' ||
+		    rd->line[0] == '\0')
+			continue;
+
+		if (numnodes == maxnodes) {
+			maxnodes = maxnodes * 2 + 64;
+			nodes = realloc(nodes, maxnodes * sizeof(*nodes));
+			if (nodes == NULL)
+				exit(1);
+			if (numnodes == 0) {
+				/* The empty node. */
+				memset(&nodes[0], 0, sizeof(nodes[0]));
+				numnodes++;
+			}
+		}
+		node = &nodes[numnodes];
+		memset(node, 0, sizeof(*node));
+
+		pos = rd->line;
+		if (*pos == '.' || *pos == '*' || *pos == '$') {
+			node->level = 3;
+			node->leaf = True;
+			for (x = y = 0; *pos != '\0'; pos++) {
+				if (*pos == '$') {
+					x = 0;
+					y++;
+					continue;
+				}
+				if (x >= 8 || y >= 8)
+					goto done;
+				if (*pos == '*')
+					node->bits |=
+					    (uint64_t)1 << (y * 8 + x);
+				x++;
+			}
+			numnodes++;
+			continue;
+		}
+
+		value = life_reader_number(pos, &endptr);
+		if (endptr == pos || value < 1 || value > MACROCELL_MAXLEVEL)
+			goto done;
+		node->level = value;
+		node->leaf = node->level == 1;
+		for (i = 0; i < 4; i++) {
+			pos = endptr;
+			value = life_reader_number(pos, &endptr);
+			if (endptr == pos || value < 0)
+				goto done;
+			if (node->level == 1) {
+				/* Cell states: NW, NE, SW, SE. */
+				if (value != 0)
+					node->bits |= (uint64_t)1 <<
+					    ((i / 2) * 8 + (i % 2));
+				continue;
+			}
+			/* Children must come first, one level down. */
+			if (value >= numnodes || (value != 0 &&
+			    nodes[value].level != node->level - 1))
+				goto done;
+			if (!MACROCELL_EMPTY(&nodes[value]))
+				node->child[i] = value;
+		}
+		numnodes++;
+	} while (life_reader_line(rd));
+
+	if (numnodes > 1)
+		rv = life_macrocell_cells(rd, nodes, numnodes - 1, 0, 0);
+done:
+	free(nodes);
+	return (rv);
+}
+
+
+/*
+ * life_macrocell_cells() - Add the live cells in a macrocell node.
+ *
+ *	x and y are the position of the node's top left corner.
+ */
+static
+int
+life_macrocell_cells(struct life_reader *rd, const struct life_mcnode *nodes,
+		     unsigned int idx, int64_t x, int64_t y)
+{
+	const struct life_mcnode *node = &nodes[idx];
+	int64_t half;
+	uint64_t bits;
+	int bit;
+	int i;
+
+	if (node->leaf) {
+		for (bits = node->bits, bit = 0; bits != 0;
+		     bits >>= 1, bit++) {
+			if ((bits & 1) &&
+			    !life_reader_cell(rd, x + bit % 8, y + bit / 8))
+				return (False);
+		}
+		return (True);
+	}
+
+	half = (int64_t)1 << (node->level - 1);
+	for (i = 0; i < 4; i++) {
+		if (node->child[i] != 0 &&
+		    !life_macrocell_cells(rd, nodes, node->child[i],
+					  x + (i % 2) * half,
+					  y + (i / 2) * half))
+			return (False);
+	}
+	return (True);
+}
+
+
+/*
+ * life_pattern_read() - Parse a pattern stored in a file.
+ *
+ *	If the file is an unknown format or the pattern is too large, then
+ *	returns boolean false.  Otherwise, returns boolean true and populates
+ *	the given pattern structure with data from the file.
+ *	Large collections of patterns in all of these formats can be found
+ *	at http://www.conwaylife.com/ and in Golly's pattern library.
+ */
+int
+life_pattern_read(const struct life_state * const st, const char *filename,
+		  struct pattern *pattern)
+{
+	struct life_reader rd;
+	struct coords *coord;
+	const char *pos;
+	int rv;
+
+	memset(&rd, 0, sizeof(rd));
+	rd.f = fopen(filename, "r");
+	if (rd.f == NULL)
+		return (False);
+	rd.linesize = READER_LINESIZE;
+	rd.line = malloc(rd.linesize);
+	if (rd.line == NULL)
+		exit(1);
+
+	/*
+	 * Don't bother with patterns which are too big to be displayed in
+	 * any meaningful manner.
+	 */
+	rd.limitX = st->cell_numX / 2;
+	rd.limitY = st->cell_numY / 2;
+	rd.limitcoords = (unsigned long)(rd.limitX + 1) * (rd.limitY + 1);
+
+	/*
+	 * Skip over comments until the format is known.  The line which
+	 * gives it away is left for the reader for that format.
+	 */
+	rv = False;
+	while (life_reader_line(&rd)) {
+		if (strncmp(rd.line, "#Life 1.06", 10) == 0) {
+			rv = life_read_life106(&rd);
+			break;
+		}
+		if (strncmp(rd.line, "#Life 1.05", 10) == 0 ||
+		    strncmp(rd.line, "#P", 2) == 0) {
+			rv = life_read_life105(&rd);
+			break;
+		}
+		if (strncmp(rd.line, "[M2]", 4) == 0) {
+			rv = life_read_macrocell(&rd);
+			break;
+		}
+		if (rd.line[0] == '!') {
+			rv = life_read_plaintext(&rd);
+			break;
+		}
+		if (rd.line[0] == '#')
+			continue;
+
+		for (pos = rd.line; isspace((unsigned char)*pos); pos++)
+			continue;
+		if (pos[0] == 'x' && (pos[1] == '=' ||
+		    isspace((unsigned char)pos[1]))) {
+			rv = life_read_rle(&rd);
+			break;
+		}
+		rv = life_read_life105(&rd);
+		break;
+	}
+	fclose(rd.f);
+	free(rd.line);
+
+	/* Ignore empty patterns. */
+	if (!rv || rd.numcoords == 0) {
+		free(rd.coords);
+		return (False);
+	}
+
+	/*
+	 * Calculate the width of the pattern.
+	 * This is actually 1 less than the width, but every it is used had to
+	 * subtract 1 to get a useable value, so we just subtract the one here
+	 * and be done with it.
+	 */
+	pattern->width = rd.maxX - rd.minX;
+	pattern->height = rd.maxY - rd.minY;
+
+	/*
+	 * Normalize the pattern's cell coordinates such that the minimum X
+	 * and Y values are both 0.
+	 */
+	for (coord = rd.coords; coord < rd.coords + rd.numcoords; coord++) {
+		coord->x -= rd.minX;
+		coord->y -= rd.minY;
+	}
+
+	/* Finally, hand the coordinate data over to the pattern record. */
+	pattern->numcoords = rd.numcoords;
+	pattern->coords = realloc(rd.coords,
+				  rd.numcoords * sizeof(*rd.coords));
+	if (pattern->coords == NULL)
+		pattern->coords = rd.coords;
+	return (True);
+}
+
+
+/*
+ * life_pack_open() - Map a pattern pack into memory.
+ *
+ *	Only the header and index are checked here, so opening a pack costs
+ *	the same however many patterns it holds.  Returns NULL if the file is
+ *	not a pack made on a machine like this one.
+ */
+struct pattern_pack *
+life_pack_open(const char *filename)
+{
+	const struct pattern_packheader *header;
+	struct pattern_pack *pack;
+	struct stat sb;
+	void *base;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return (NULL);
+	if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) ||
+	    (size_t)sb.st_size < sizeof(*header)) {
+		close(fd);
+		return (NULL);
+	}
+	base = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return (NULL);
+
+	header = base;
+	if (memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->byteorder != PACK_BYTEORDER ||
+	    header->coordsize != sizeof(struct coords) ||
+	    header->numpatterns > ((size_t)sb.st_size - sizeof(*header)) /
+	    sizeof(struct pattern_packentry)) {
+		munmap(base, sb.st_size);
+		return (NULL);
+	}
+
+	pack = malloc(sizeof(*pack));
+	if (pack == NULL)
+		exit(1);
+	pack->next = NULL;
+	pack->base = base;
+	pack->size = sb.st_size;
+	pack->entries = (const struct pattern_packentry *)(header + 1);
+	pack->numpatterns = header->numpatterns;
+	return (pack);
+}
+
+
+/*
+ * life_pack_pattern() - Point a pattern at one in a pack.
+ *
+ *	Nothing is copied; the pattern's coordinates are those in the mapping,
+ *	so they are checked to lie within its bounding box first.  Returns
+ *	boolean false, like life_pattern_read(), if the pattern is too large
+ *	for the view, or if the pack is damaged.
+ */
+int
+life_pack_pattern(const struct life_state * const st,
+		  const struct pattern_pack *pack, unsigned int idx,
+		  struct pattern *pattern)
+{
+	const struct pattern_packentry *entry;
+	const struct coords *coords;
+	unsigned int i;
+
+	if (idx >= pack->numpatterns)
+		return (False);
+	entry = &pack->entries[idx];
+	if (entry->width > (unsigned int)st->cell_numX / 2 ||
+	    entry->height > (unsigned int)st->cell_numY / 2)
+		return (False);
+
+	if (entry->numcoords == 0 || entry->offset > pack->size ||
+	    entry->offset % sizeof(int) != 0 ||
+	    entry->numcoords > (pack->size - entry->offset) /
+	    sizeof(struct coords))
+		return (False);
+	coords = (const struct coords *)((const char *)pack->base +
+					 entry->offset);
+	for (i = 0; i < entry->numcoords; i++) {
+		if (coords[i].x < 0 || coords[i].x > (int)entry->width ||
+		    coords[i].y < 0 || coords[i].y > (int)entry->height)
+			return (False);
+	}
+
+	pattern->width = entry->width;
+	pattern->height = entry->height;
+	pattern->numcoords = entry->numcoords;
+	pattern->coords = (struct coords *)coords;
+	return (True);
+}
+
+
+/*
+ * life_pack_close() - Unmap a pattern pack.
+ */
+void
+life_pack_close(struct pattern_pack *pack)
+{
+
+	munmap(pack->base, pack->size);
+	free(pack);
+}
+
+
+/*
+ * life_pattern_orient() - Find where a cell of a pattern goes when oriented.
+ */
+void
+life_pattern_orient(const struct pattern *pattern, int orientation,
+		    const struct coords *coord, struct coords *oriented)
+{
+	unsigned int width, height;
+
+	if (orientation & ORIENT_TRANSPOSE) {
+		oriented->x = coord->y;
+		oriented->y = coord->x;
+		width = pattern->height;
+		height = pattern->width;
+	} else {
+		*oriented = *coord;
+		width = pattern->width;
+		height = pattern->height;
+	}
+	if (orientation & ORIENT_FLIPX)
+		oriented->x = width - oriented->x;
+	if (orientation & ORIENT_FLIPY)
+		oriented->y = height - oriented->y;
+}
+
+
+/*
+ * life_pattern_stamp() - Rasterize a pattern in each of its orientations.
+ *
+ *	The bitmaps of all of the orientations share one allocation, which
+ *	for the largest patterns allowed on a large display comes to a few
+ *	megabytes.
+ */
+void
+life_pattern_stamp(struct pattern *pattern)
+{
+	struct pattern_orientation *orient;
+	struct pattern_stamp *stamp;
+	struct coords oriented;
+	unsigned int i;
+	size_t numwords;
+	int orientation;
+
+	stamp = malloc(sizeof(*stamp));
+	if (stamp == NULL)
+		exit(1);
+
+	numwords = 0;
+	for (orientation = 0; orientation < NUMORIENTATIONS; orientation++) {
+		orient = &stamp->orientations[orientation];
+		if (orientation & ORIENT_TRANSPOSE) {
+			orient->width = pattern->height;
+			orient->height = pattern->width;
+		} else {
+			orient->width = pattern->width;
+			orient->height = pattern->height;
+		}
+		orient->rowwords = orient->width / 64 + 2;
+		numwords += (size_t)(orient->height + 1) * orient->rowwords;
+	}
+	stamp->bits = calloc(numwords, sizeof(stamp->bits[0]));
+	if (stamp->bits == NULL)
+		exit(1);
+
+	numwords = 0;
+	for (orientation = 0; orientation < NUMORIENTATIONS; orientation++) {
+		orient = &stamp->orientations[orientation];
+		orient->bits = stamp->bits + numwords;
+		numwords += (size_t)(orient->height + 1) * orient->rowwords;
+
+		for (i = 0; i < pattern->numcoords; i++) {
+			life_pattern_orient(pattern, orientation,
+					    &pattern->coords[i], &oriented);
+			orient->bits[(size_t)oriented.y * orient->rowwords +
+			    oriented.x / 64] |= (uint64_t)1 << (oriented.x % 64);
+		}
+	}
+
+	/* Patterns may start anywhere within a cluster. */
+	i = pattern->width > pattern->height ? pattern->width :
+	    pattern->height;
+	stamp->slots = calloc(i / CLUSTERSIZE + 2, sizeof(stamp->slots[0]));
+	if (stamp->slots == NULL)
+		exit(1);
+
+	pattern->stamp = stamp;
+}
+
+
+/*
+ * life_stamp_free() - Free a pattern stamp.
+ */
+void
+life_stamp_free(struct pattern_stamp *stamp)
+{
+
+	free(stamp->slots);
+	free(stamp->bits);
+	free(stamp);
+}
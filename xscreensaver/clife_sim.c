@@ -0,0 +1,3625 @@
+/*
+ * Copyright (c) 2003,2007 Kelly Yancey (kbyanc@posi.net)
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+/* Undefine the following before testing any code changes! */
+#define NDEBUG
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "yarandom.h"
+#include "clife_sim.h"
+#include "clife_hashlife.h"
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define LIFE_SIMD
+# include <immintrin.h>
+#endif
+
+
+/*
+ * Additional debugging aids:
+ *	LIFE_PRINTPATTERNS - Define to print which patterns were loaded.
+ */
+#undef LIFE_PRINTPATTERNS
+
+
+/*
+ * Data structures for representing Life patterns.
+ * We will attempt to load any pattern files found in the path specified via
+ * the -patterns command-line parameter or the patternPath resource; see
+ * clife_pattern.c for the formats understood.  To keep things interesting
+ * for people who do not have a pattern collection to pull from, we include
+ * 3 built-in patterns.  Please don't add more.  If you want more patterns,
+ * store them in files and put the directory to find those files in your
+ * patternPath.
+ */
+static struct coords builtin_pattern_coords[] = {
+#define	BUILTIN_PATTERN_GLIDER	(builtin_pattern_coords + 0)
+	{ 0, 0 }, { 1, 0 }, { 2, 0 },
+	{ 0, 1 },
+		  { 1, 2 },
+
+#define	BUILTIN_PATTERN_BHEPT	(builtin_pattern_coords + 5)
+		  { 1, 0 },
+	{ 0, 1 }, { 1, 1 }, { 2, 1 },
+	{ 0, 2 },	    { 2, 2 }, { 3, 2 },
+
+#define	BUILTIN_PATTERN_RABBITS	(builtin_pattern_coords + 12)
+	{ 0, 0 }, 				{ 4, 0 }, { 5, 0 }, { 6, 0 },
+	{ 0, 1 }, { 1, 1 }, { 2, 1 },			  { 5, 1 },
+		  { 1, 2 },
+
+	/* Offset 21: End-of-List */
+};
+
+static const struct pattern builtin_patterns[NUMPATTERNSBUILTIN] = {
+	{  3,  3,  5, BUILTIN_PATTERN_GLIDER, NULL },
+	{  4,  3,  7, BUILTIN_PATTERN_BHEPT, NULL },
+	{  7,  3,  9, BUILTIN_PATTERN_RABBITS, NULL }
+};
+
+
+static const struct coords direction_offset[NUMDIRECTIONS] = {
+	{ -1, -1 }, { 0, -1 }, { 1, -1 },
+	{ -1,  0 },	       { 1,  0 },
+	{ -1,  1 }, { 0,  1 }, { 1,  1 }
+};
+
+
+
+/*
+ * Clusters are found by their coordinates through an open-addressing hash
+ * table with linear probing, so the universe need not be the size of the
+ * display: it may be a torus several times larger, or unbounded, with the
+ * display showing just part of it.  Most lookups are avoided altogether by
+ * following the neighbor pointers cached in each cluster.
+ *	LIFE_TABLEMIN	- Minimum number of slots in the cluster table.
+ *	LIFE_MAXSCALE	- Upper limit on the universeScale resource.
+ */
+#define	LIFE_TABLEMIN	64
+#define	LIFE_MAXSCALE	1024
+
+
+
+#ifdef HAVE_PTHREAD
+/*
+ * Multi-threaded simulation.  See life_threads_init() for how the work is
+ * divided up.
+ *	LIFE_MAXTHREADS		- Upper limit on the threads resource.
+ *	LIFE_STRIPESPERTHREAD	- Number of stripes per thread.
+ */
+#define	LIFE_MAXTHREADS		64
+#define	LIFE_STRIPESPERTHREAD	4
+
+struct life_stripe {
+	int		 first;		/* First worklist entry. */
+	int		 last;		/* One past the last entry. */
+	unsigned int	 randstate;	/* rand_r() state for cell colors. */
+	int		 numcells;	/* Change in number of cells. */
+	int		 births;
+
+	/* Clusters to wake neighbors of or to deactivate. */
+	struct cell_cluster **pending;
+	int		 numpending;
+	int		 maxpending;
+};
+
+struct life_threadpool {
+	pthread_mutex_t	 lock;
+	pthread_cond_t	 start;		/* Signalled to start a generation. */
+	pthread_cond_t	 done;		/* Signalled when workers are done. */
+	pthread_t	*threads;
+	int		 numthreads;	/* Not counting the calling thread. */
+	unsigned int	 generation;
+	int		 busy;		/* Workers still running. */
+	int		 shutdown;
+
+	struct life_stripe *stripes;
+	int		 numstripes;
+	int		 nextstripe;	/* Next stripe to hand out. */
+};
+#endif /* HAVE_PTHREAD */
+
+/*
+ * Pattern loading.  life_pattern_init() picks up to NUMPATTERNS files, or
+ * patterns in packs, at random from the pattern path and parses them; it
+ * may leave this to a background thread so that the first frame does not
+ * wait on reading the pattern path.  Patterns are only drawn by the thread
+ * calling life_state_update(), so the loader fills an array of its own and
+ * that thread copies the patterns out of it once the loader is done; see
+ * life_pattern_poll().
+ */
+struct pattern_source {
+	char		*filename;
+	struct pattern_pack *pack;	/* Or from this pack. */
+	unsigned int	 idx;
+};
+
+struct pattern_loader {
+	struct life_state limits;	/* Only the size of the view is set. */
+	char		*path;
+	unsigned int	 randstate;	/* rand_r() state for picking files. */
+	int		 numthreads;
+	struct pattern_source sources[NUMPATTERNS];
+	struct pattern	 patterns[NUMPATTERNS];	/* Parsed from sources. */
+	int		 loaded[NUMPATTERNS];
+	struct pattern_pack *packs;
+	int		 nextsource;	/* Next source to parse. */
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t	 lock;		/* For nextsource and below. */
+	pthread_t	 thread;
+	int		 done;
+	int		 cancel;	/* Set by life_pattern_free(). */
+#endif
+};
+
+
+
+
+static void	 life_state_view(struct life_state *st, int cell_numX,
+				 int cell_numY);
+static void	 life_table_alloc(struct life_state *st);
+static int	 life_viewmap_find(struct life_state *st, int numX, int numY,
+				   int *viewX, int *viewY);
+static void	 life_table_insert(struct life_state *st,
+				   struct cell_cluster *cluster);
+static struct cell_cluster *life_pool_alloc(struct life_state *st);
+static void	 life_pool_release(struct life_state *st,
+				   struct cell_cluster *cluster);
+static void	 life_pool_free(struct life_state *st);
+static struct cell_cluster *life_cluster_new(struct life_state *st,
+					     int clusterX, int clusterY);
+static void	 life_cluster_delete(struct life_state *st,
+				     struct cell_cluster *cluster);
+static int	 life_cluster_update_bytewise(struct life_state *st,
+					      struct cell_cluster *cluster,
+					      unsigned int *randstate);
+static int	 life_cluster_update_swar(struct life_state *st,
+					  struct cell_cluster *cluster,
+					  unsigned int *randstate);
+#ifdef LIFE_SIMD
+static int	 life_cluster_update_sse2(struct life_state *st,
+					  struct cell_cluster *cluster,
+					  unsigned int *randstate);
+static int	 life_cluster_update_avx2(struct life_state *st,
+					  struct cell_cluster *cluster,
+					  unsigned int *randstate);
+#endif
+static int	(*life_cluster_update_simd(void))(struct life_state *st,
+					  struct cell_cluster *cluster,
+					  unsigned int *randstate);
+static void	 life_cluster_markwake(const struct life_state *st,
+				       struct cell_cluster *cluster,
+				       clusterrow changemapX,
+				       clusterrow changemapY);
+static void	 life_cluster_wake(struct life_state *st,
+				   struct cell_cluster *cluster);
+static void	 life_cluster_wakeneighbor(struct life_state *st,
+					   const struct cell_cluster *cluster,
+					   int xoffset, int yoffset);
+static void	 life_cluster_wakeedges(struct life_state *st,
+					struct cell_cluster *cluster);
+
+static void	 life_hashlife_init(struct life_state *st,
+				    const struct life_params *params);
+static void	 life_hashlife_view(struct life_state *st);
+static void	 life_hashlife_resize(struct life_state *st,
+				      int oldcell_numX, int oldcell_numY);
+static void	 life_hashlife_free(struct life_state *st);
+static void	 life_hashlife_recolor(struct life_state *st);
+static void	 life_hashlife_update(struct life_state *st);
+
+static void	 life_pattern_add(struct life_state *st);
+static int	 life_pattern_draw(struct life_state *st);
+
+#ifdef HAVE_PTHREAD
+static void	 life_threads_init(struct life_state *st);
+static void	 life_threads_free(struct life_state *st);
+static void	*life_thread_main(void *arg);
+#endif
+
+
+
+/*
+ * life_state_view() - Size the view to fit the given number of cells.
+ *
+ *	The view is a whole number of clusters, at least 1 each way.
+ */
+static
+void
+life_state_view(struct life_state *st, int cell_numX, int cell_numY)
+{
+
+	st->cluster_numX = cell_numX / CLUSTERSIZE;
+	st->cluster_numY = cell_numY / CLUSTERSIZE;
+	if (st->cluster_numX < 1)
+		st->cluster_numX = 1;
+	if (st->cluster_numY < 1)
+		st->cluster_numY = 1;
+	st->cell_numX = st->cluster_numX * CLUSTERSIZE;
+	st->cell_numY = st->cluster_numY * CLUSTERSIZE;
+	st->maxcells = st->cell_numX * st->cell_numY;
+	st->maxclusters = st->cluster_numX * st->cluster_numY;
+
+	/* Empty, until life_state_pan() is called to fill it in. */
+	free(st->viewmap);
+	st->viewmapwords = (st->cluster_numX + 63) / 64;
+	st->viewmap = calloc((size_t)(st->cluster_numY + 1) * st->viewmapwords,
+			     sizeof(*st->viewmap));
+	if (st->viewmap == NULL)
+		exit(1);
+}
+
+
+/*
+ * life_table_alloc() - Allocate an empty cluster lookup table.
+ *
+ *	There is room for at least twice as many clusters as fit in the view,
+ *	or as there are, whichever is more; it grows as needed.  All pointers
+ *	start out NULL to indicate an empty universe.
+ */
+static
+void
+life_table_alloc(struct life_state *st)
+{
+	unsigned int tablesize;
+
+	tablesize = LIFE_TABLEMIN;
+	while (tablesize < (unsigned int)st->maxclusters * 2 ||
+	       tablesize < (unsigned int)st->numclusters * 2)
+		tablesize <<= 1;
+	st->clustertable = calloc(tablesize, sizeof(*st->clustertable));
+	if (st->clustertable == NULL)
+		exit(1);
+	st->clustermask = tablesize - 1;
+}
+
+
+void
+life_state_init(struct life_state *st, const struct life_params *params)
+{
+	int scale;
+
+	/*
+	 * Select the generation kernel.  All produce identical results; the
+	 * bytewise kernel is kept around for comparison.
+	 */
+	st->cluster_update = life_cluster_update_swar;
+	if (params->kernel != NULL) {
+		if (strcmp(params->kernel, "bytewise") == 0)
+			st->cluster_update = life_cluster_update_bytewise;
+		else if (strcmp(params->kernel, "simd") == 0)
+			st->cluster_update = life_cluster_update_simd();
+		else if (strcmp(params->kernel, "swar") != 0)
+			fprintf(stderr, "%s: unknown kernel \"%s\"\n",
+				params->progname, params->kernel);
+	}
+
+	/* See the note on colors in life_display_init() in clife.c. */
+	st->numcolors = params->numcolors;
+	if (st->numcolors < 1)
+		st->numcolors = 1;
+	else if (st->numcolors > CELL_MAXCOLORS)
+		st->numcolors = CELL_MAXCOLORS;
+	st->colorwrap = st->numcolors * 3;
+
+	st->cellmaxage = params->maxage;
+	if (st->cellmaxage < 1)
+		st->cellmaxage = 0;
+	else if (st->cellmaxage > UCHAR_MAX)
+		st->cellmaxage = UCHAR_MAX;
+
+	/*
+	 * Only the last of several generations per frame is drawn, and frames
+	 * may be skipped altogether; see the note on the dormant counter
+	 * above struct cell_cluster.
+	 */
+	st->gensperdraw = params->gensperdraw;
+	if (st->gensperdraw < 1)
+		st->gensperdraw = 1;
+	else if (st->gensperdraw > LIFE_MAXGENSPERFRAME)
+		st->gensperdraw = LIFE_MAXGENSPERFRAME;
+	st->limitdraw = LIMIT_DRAW + st->gensperdraw - 1;
+	st->limitupdate = LIMIT_UPDATE + st->gensperdraw - 1;
+
+	st->viewmap = NULL;
+	life_state_view(st, params->cell_numX, params->cell_numY);
+
+	/*
+	 * Size the universe.  A scale of 1 makes the universe a torus the
+	 * size of the view, larger scales make the torus that many times
+	 * larger in each direction, and 0 makes it unbounded.  The view
+	 * starts out showing the top left corner (or the origin).
+	 */
+	scale = params->scale;
+	if (scale < 0)
+		scale = 1;
+	else if (scale > LIFE_MAXSCALE)
+		scale = LIFE_MAXSCALE;
+	st->universe_numX = st->cluster_numX * scale;
+	st->universe_numY = st->cluster_numY * scale;
+	st->view_clusterX = 0;
+	st->view_clusterY = 0;
+
+	st->numcells = 0;
+	st->numclusters = 0;
+	life_table_alloc(st);
+	TAILQ_INIT(&st->active);
+	TAILQ_INIT(&st->idle);
+	memset(&st->clusterpool, 0, sizeof(st->clusterpool));
+	st->numvisible = 0;
+	st->iteration = 0;
+	st->parity = 0;
+	st->numactive = 0;
+	st->nofill = params->nofill;
+	memset(&st->counters, 0, sizeof(st->counters));
+
+	/* Select the engine; the cluster engine is always set up. */
+	st->hashlife = NULL;
+	if (params->engine != NULL) {
+		if (strcmp(params->engine, "hashlife") == 0)
+			life_hashlife_init(st, params);
+		else if (strcmp(params->engine, "clusters") != 0)
+			fprintf(stderr, "%s: unknown engine \"%s\"\n",
+				params->progname, params->engine);
+	}
+
+	/*
+	 * Start worker threads if requested.  A thread count of 0 means one
+	 * thread per processor.
+	 */
+	st->numthreads = params->numthreads;
+#ifdef HAVE_PTHREAD
+	if (st->numthreads < 1)
+		st->numthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (st->numthreads > LIFE_MAXTHREADS)
+		st->numthreads = LIFE_MAXTHREADS;
+	st->pool = NULL;
+	if (st->numthreads > 1 && st->hashlife == NULL)
+		life_threads_init(st);
+#endif
+	if (st->numthreads < 1)
+		st->numthreads = 1;
+}
+
+
+void
+life_state_free(struct life_state *st)
+{
+
+#ifdef HAVE_PTHREAD
+	if (st->pool != NULL)
+		life_threads_free(st);
+#endif
+	if (st->hashlife != NULL)
+		life_hashlife_free(st);
+	life_pool_free(st);
+	free(st->clustertable);
+	free(st->viewmap);
+}
+
+
+/*
+ * Which clusters in the view exist is kept in a bitmap, st->viewmap, with a
+ * row of st->viewmapwords words per row of clusters and the bit for view
+ * cluster (x, y) at bit (x % 64) of word (x / 64) of row y.  It is kept up
+ * to date by life_cluster_new() and life_cluster_delete(), alongside
+ * st->numvisible, and rebuilt whenever the view moves.  An extra row at
+ * the end is scratch space for life_viewmap_find().
+ */
+static __inline
+void
+life_viewmap_set(struct life_state *st, int viewX, int viewY, int exists)
+{
+	uint64_t *word;
+
+	word = &st->viewmap[(size_t)viewY * st->viewmapwords + viewX / 64];
+	if (exists)
+		*word |= (uint64_t)1 << (viewX % 64);
+	else
+		*word &= ~((uint64_t)1 << (viewX % 64));
+}
+
+
+/*
+ * life_viewmap_find() - Find numX by numY clusters in the view, all empty.
+ *
+ *	The block must not exist at all yet, and lie entirely within the
+ *	view.  The search starts at a random row and wraps around; within a
+ *	row, the first block at or after a random column is taken, or else
+ *	the first block in the row.  Each row is checked against the numY
+ *	rows below it a word at a time, so even a full view costs only a few
+ *	operations per cluster.  Returns boolean false if there is no room.
+ */
+static
+int
+life_viewmap_find(struct life_state *st, int numX, int numY,
+		  int *viewX, int *viewY)
+{
+	uint64_t *window;
+	const uint64_t *row;
+	int numrows;
+	int startX, startY;
+	int first;
+	int run;
+	int x, y;
+	int i, j;
+
+	if (numX > st->cluster_numX || numY > st->cluster_numY)
+		return (False);
+
+	window = &st->viewmap[(size_t)st->cluster_numY * st->viewmapwords];
+	numrows = st->cluster_numY - numY + 1;
+	startY = random() % numrows;
+	startX = random() % st->cluster_numX;
+
+	for (i = 0; i < numrows; i++) {
+		y = (startY + i) % numrows;
+
+		/* Which columns have a cluster in any of the numY rows. */
+		row = &st->viewmap[(size_t)y * st->viewmapwords];
+		memcpy(window, row, st->viewmapwords * sizeof(*window));
+		for (j = 1; j < numY; j++) {
+			row += st->viewmapwords;
+			for (x = 0; x < st->viewmapwords; x++)
+				window[x] |= row[x];
+		}
+
+		first = -1;
+		run = 0;
+		for (x = 0; x < st->cluster_numX; x++) {
+			if (x % 64 == 0 && window[x / 64] == ~(uint64_t)0) {
+				run = 0;
+				x += 63;
+				continue;
+			}
+			if (window[x / 64] & ((uint64_t)1 << (x % 64))) {
+				run = 0;
+				continue;
+			}
+			if (++run < numX)
+				continue;
+			if (x - numX + 1 >= startX) {
+				first = x - numX + 1;
+				break;
+			}
+			if (first < 0)
+				first = x - numX + 1;
+		}
+		if (first >= 0) {
+			*viewX = first;
+			*viewY = y;
+			return (True);
+		}
+	}
+	return (False);
+}
+
+
+/*
+ * life_state_pan() - Move the view by the given number of clusters.
+ */
+void
+life_state_pan(struct life_state *st, int xoffset, int yoffset)
+{
+	struct cell_cluster_list *lists[2] = { &st->active, &st->idle };
+	struct cell_cluster *cluster;
+	int viewX, viewY;
+	int i;
+
+	st->view_clusterX += xoffset;
+	st->view_clusterY += yoffset;
+	life_cluster_wrap(st, &st->view_clusterX, &st->view_clusterY);
+
+	/* Recount the clusters in the view. */
+	st->numvisible = 0;
+	memset(st->viewmap, 0, (size_t)st->cluster_numY * st->viewmapwords *
+	       sizeof(*st->viewmap));
+	for (i = 0; i < 2; i++) {
+		TAILQ_FOREACH(cluster, lists[i], link) {
+			if (life_cluster_visible(st, cluster->clusterX,
+						 cluster->clusterY,
+						 &viewX, &viewY)) {
+				st->numvisible++;
+				life_viewmap_set(st, viewX, viewY, True);
+			}
+		}
+	}
+}
+
+
+/*
+ * life_time() - Current time in microseconds.
+ */
+int64_t
+life_time(void)
+{
+	struct timeval now;
+#ifdef GETTIMEOFDAY_TWO_ARGS
+	struct timezone tzp;
+
+	gettimeofday(&now, &tzp);
+#else
+	gettimeofday(&now);
+#endif
+	return ((int64_t)now.tv_sec * 1000000 + now.tv_usec);
+}
+
+
+/*
+ * life_cluster_activate() - Move a cluster onto the active list.
+ * life_cluster_deactivate() - Move a cluster onto the idle list.
+ */
+static __inline
+void
+life_cluster_activate(struct life_state *st, struct cell_cluster *cluster)
+{
+
+	if (cluster->active)
+		return;
+	TAILQ_REMOVE(&st->idle, cluster, link);
+	TAILQ_INSERT_TAIL(&st->active, cluster, link);
+	cluster->active = True;
+	st->counters.woken++;
+}
+
+
+static __inline
+void
+life_cluster_deactivate(struct life_state *st, struct cell_cluster *cluster)
+{
+
+	if (!cluster->active)
+		return;
+	TAILQ_REMOVE(&st->active, cluster, link);
+	TAILQ_INSERT_TAIL(&st->idle, cluster, link);
+	cluster->active = False;
+}
+
+
+/*
+ * life_state_resize() - Change the size of the view without starting over.
+ *
+ *	A bounded universe keeps its scale, so it grows or shrinks with the
+ *	view.  Clusters keep their place relative to the top left corner of
+ *	the view, which becomes the top left corner of the universe; those
+ *	which no longer fit are dropped along with their cells.  The cluster
+ *	table and all neighbor links are rebuilt in one pass afterwards, and
+ *	every cluster is woken since its neighbors may have changed.  An
+ *	unbounded universe only needs the view resized.
+ */
+void
+life_state_resize(struct life_state *st, int cell_numX, int cell_numY)
+{
+	struct cell_cluster *cluster, *next;
+	int olduniverseX, olduniverseY;
+	int oldcell_numX, oldcell_numY;
+	int clusterX, clusterY;
+	int neighboridx;
+	int scale;
+
+	olduniverseX = st->universe_numX;
+	olduniverseY = st->universe_numY;
+	oldcell_numX = st->cell_numX;
+	oldcell_numY = st->cell_numY;
+	scale = st->universe_numX / st->cluster_numX;
+
+	life_state_view(st, cell_numX, cell_numY);
+	if (st->hashlife != NULL)
+		life_hashlife_resize(st, oldcell_numX, oldcell_numY);
+	if (scale == 0) {
+		life_state_pan(st, 0, 0);
+		return;
+	}
+	st->universe_numX = st->cluster_numX * scale;
+	st->universe_numY = st->cluster_numY * scale;
+
+	while ((cluster = TAILQ_FIRST(&st->idle)) != NULL) {
+		TAILQ_REMOVE(&st->idle, cluster, link);
+		TAILQ_INSERT_TAIL(&st->active, cluster, link);
+		cluster->active = True;
+	}
+
+	for (cluster = TAILQ_FIRST(&st->active); cluster != NULL;
+	     cluster = next) {
+		next = TAILQ_NEXT(cluster, link);
+
+		clusterX = cluster->clusterX - st->view_clusterX;
+		if (clusterX < 0)
+			clusterX += olduniverseX;
+		clusterY = cluster->clusterY - st->view_clusterY;
+		if (clusterY < 0)
+			clusterY += olduniverseY;
+
+		if (clusterX >= st->universe_numX ||
+		    clusterY >= st->universe_numY) {
+			TAILQ_REMOVE(&st->active, cluster, link);
+			st->numcells -= cluster->numcells;
+			st->numclusters--;
+			st->counters.deleted++;
+			life_pool_release(st, cluster);
+			continue;
+		}
+		cluster->clusterX = clusterX;
+		cluster->clusterY = clusterY;
+		cluster->dormant = 0;
+	}
+	st->view_clusterX = 0;
+	st->view_clusterY = 0;
+
+	free(st->clustertable);
+	life_table_alloc(st);
+	TAILQ_FOREACH(cluster, &st->active, link)
+		life_table_insert(st, cluster);
+
+	TAILQ_FOREACH(cluster, &st->active, link) {
+		for (neighboridx = 0; neighboridx < NUMDIRECTIONS;
+		     neighboridx++) {
+			clusterX = cluster->clusterX +
+			    direction_offset[neighboridx].x;
+			clusterY = cluster->clusterY +
+			    direction_offset[neighboridx].y;
+			life_cluster_wrap(st, &clusterX, &clusterY);
+			cluster->neighbor[neighboridx] =
+			    life_cluster_lookup(st, clusterX, clusterY);
+		}
+	}
+
+	/*
+	 * Cells on an edge which used to wrap around may now face empty
+	 * space, which needs clusters for births to go in.  Clusters created
+	 * here go on the end of the list and are empty.
+	 */
+	TAILQ_FOREACH(cluster, &st->active, link)
+		life_cluster_wakeedges(st, cluster);
+
+	life_state_pan(st, 0, 0);
+}
+
+
+/*
+ * life_cluster_wakeedges() - Wake the neighbors next to any live edge cells.
+ */
+static
+void
+life_cluster_wakeedges(struct life_state *st, struct cell_cluster *cluster)
+{
+	cell (*cells)[CLUSTERSIZE];
+	int north, south, west, east;
+	int i;
+
+	if (cluster->numcells == 0)
+		return;
+
+	cells = LIFE_CURGEN(st, cluster);
+	north = south = west = east = False;
+	for (i = 0; i < CLUSTERSIZE; i++) {
+		north |= cells[0][i] != CELL_DEAD;
+		south |= cells[CLUSTERSIZE - 1][i] != CELL_DEAD;
+		west |= cells[i][0] != CELL_DEAD;
+		east |= cells[i][CLUSTERSIZE - 1] != CELL_DEAD;
+	}
+
+	if (cells[0][0] != CELL_DEAD)
+		life_cluster_wakeneighbor(st, cluster, -1, -1);		/* NW */
+	if (north)
+		life_cluster_wakeneighbor(st, cluster, 0, -1);		/* N */
+	if (cells[0][CLUSTERSIZE - 1] != CELL_DEAD)
+		life_cluster_wakeneighbor(st, cluster, 1, -1);		/* NE */
+	if (west)
+		life_cluster_wakeneighbor(st, cluster, -1, 0);		/* W */
+	if (east)
+		life_cluster_wakeneighbor(st, cluster, 1, 0);		/* E */
+	if (cells[CLUSTERSIZE - 1][0] != CELL_DEAD)
+		life_cluster_wakeneighbor(st, cluster, -1, 1);		/* SW */
+	if (south)
+		life_cluster_wakeneighbor(st, cluster, 0, 1);		/* S */
+	if (cells[CLUSTERSIZE - 1][CLUSTERSIZE - 1] != CELL_DEAD)
+		life_cluster_wakeneighbor(st, cluster, 1, 1);		/* SE */
+}
+
+
+#ifdef HAVE_PTHREAD
+/*
+ * life_threads_init() - Start the worker threads for life_state_update().
+ *
+ *	Each generation, the active list is copied into the worklist which
+ *	is divided into stripes, several per thread so that a slow stripe
+ *	does not leave the other threads idle.  Stripes are handed out to the
+ *	workers (and the calling thread) in order as they ask for work.
+ */
+void
+life_threads_init(struct life_state *st)
+{
+	struct life_threadpool *pool;
+	int i;
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		exit(1);
+	pool->numstripes = st->numthreads * LIFE_STRIPESPERTHREAD;
+	pool->stripes = calloc(pool->numstripes, sizeof(*pool->stripes));
+	pool->threads = calloc(st->numthreads - 1, sizeof(*pool->threads));
+	st->worklistsize = st->maxclusters;
+	st->worklist = calloc(st->worklistsize, sizeof(*st->worklist));
+	if (pool->stripes == NULL || pool->threads == NULL ||
+	    st->worklist == NULL)
+		exit(1);
+
+	for (i = 0; i < pool->numstripes; i++)
+		pool->stripes[i].randstate = random();
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	st->pool = pool;
+
+	/* The thread calling life_state_update() is a worker too. */
+	for (i = 0; i < st->numthreads - 1; i++) {
+		if (pthread_create(&pool->threads[i], NULL,
+				   life_thread_main, st) != 0)
+			break;
+	}
+	pool->numthreads = i;
+}
+
+
+void
+life_threads_free(struct life_state *st)
+{
+	struct life_threadpool *pool = st->pool;
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = True;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->numthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	for (i = 0; i < pool->numstripes; i++)
+		free(pool->stripes[i].pending);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool->stripes);
+	free(pool);
+	free(st->worklist);
+	st->pool = NULL;
+}
+
+
+/*
+ * life_stripe_update() - Calculate the next generation of a stripe.
+ *
+ *	This is the parallel half of life_state_update().  Each cluster in
+ *	the stripe only modifies itself; neighbor wake-ups and moving
+ *	clusters to the idle list, which modify the cluster table and other
+ *	clusters, are queued on the stripe's pending list for
+ *	life_state_merge().
+ */
+static
+void
+life_stripe_update(struct life_state *st, struct life_stripe *stripe)
+{
+	struct cell_cluster *cluster;
+	int i;
+
+	stripe->numcells = 0;
+	stripe->births = 0;
+	stripe->numpending = 0;
+
+	for (i = stripe->first; i < stripe->last; i++) {
+		cluster = st->worklist[i];
+		stripe->numcells += st->cluster_update(st, cluster,
+						       &stripe->randstate);
+		if (cluster->dormant == 0)
+			stripe->births += cluster->births;
+		if (cluster->wake == 0 && cluster->dormant < st->limitupdate)
+			continue;
+
+		if (stripe->numpending == stripe->maxpending) {
+			stripe->maxpending = stripe->maxpending * 2 + 64;
+			stripe->pending = realloc(stripe->pending,
+			    stripe->maxpending * sizeof(*stripe->pending));
+			if (stripe->pending == NULL)
+				exit(1);
+		}
+		stripe->pending[stripe->numpending++] = cluster;
+	}
+}
+
+
+/*
+ * life_thread_work() - Process stripes until there are none left.
+ *
+ *	Must be called with the pool lock held; it is dropped while each
+ *	stripe is processed.
+ */
+static
+void
+life_thread_work(struct life_state *st)
+{
+	struct life_threadpool *pool = st->pool;
+	struct life_stripe *stripe;
+
+	while (pool->nextstripe < pool->numstripes) {
+		stripe = &pool->stripes[pool->nextstripe++];
+		pthread_mutex_unlock(&pool->lock);
+		life_stripe_update(st, stripe);
+		pthread_mutex_lock(&pool->lock);
+	}
+}
+
+
+static
+void *
+life_thread_main(void *arg)
+{
+	struct life_state *st = arg;
+	struct life_threadpool *pool = st->pool;
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (pool->generation == generation && !pool->shutdown)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->shutdown)
+			break;
+		generation = pool->generation;
+
+		life_thread_work(st);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return (NULL);
+}
+
+
+/*
+ * life_state_merge() - Apply the changes deferred by life_stripe_update().
+ *
+ *	All wake-ups are done before any clusters are moved to the idle list
+ *	so that a cluster which went dormant stays active if a neighbor
+ *	spills over into it.  The stripes are merged in order so that the
+ *	result only depends on the number of threads and not on their
+ *	scheduling.
+ */
+static
+void
+life_state_merge(struct life_state *st)
+{
+	struct life_threadpool *pool = st->pool;
+	struct life_stripe *stripe;
+	struct cell_cluster *cluster;
+	int i;
+
+	for (stripe = pool->stripes;
+	     stripe < pool->stripes + pool->numstripes; stripe++) {
+		st->numcells += stripe->numcells;
+		st->counters.births += stripe->births;
+		st->counters.deaths += stripe->births - stripe->numcells;
+
+		for (i = 0; i < stripe->numpending; i++) {
+			cluster = stripe->pending[i];
+			if (cluster->wake != 0)
+				life_cluster_wake(st, cluster);
+		}
+	}
+
+	for (stripe = pool->stripes;
+	     stripe < pool->stripes + pool->numstripes; stripe++) {
+		for (i = 0; i < stripe->numpending; i++) {
+			cluster = stripe->pending[i];
+			if (cluster->dormant >= st->limitupdate)
+				life_cluster_deactivate(st, cluster);
+		}
+	}
+}
+
+
+/*
+ * life_state_update_threaded() - Multi-threaded life_state_update().
+ *
+ *	Returns the number of active clusters.
+ */
+static
+int
+life_state_update_threaded(struct life_state *st)
+{
+	struct life_threadpool *pool = st->pool;
+	struct cell_cluster *cluster;
+	int numactive, perstripe;
+	int i;
+
+	/* The universe may have outgrown the worklist. */
+	if (st->numclusters > st->worklistsize) {
+		while (st->worklistsize < st->numclusters)
+			st->worklistsize *= 2;
+		free(st->worklist);
+		st->worklist = calloc(st->worklistsize,
+				      sizeof(*st->worklist));
+		if (st->worklist == NULL)
+			exit(1);
+	}
+
+	numactive = 0;
+	TAILQ_FOREACH(cluster, &st->active, link)
+		st->worklist[numactive++] = cluster;
+
+	perstripe = (numactive + pool->numstripes - 1) / pool->numstripes;
+	for (i = 0; i < pool->numstripes; i++) {
+		pool->stripes[i].first = i * perstripe;
+		pool->stripes[i].last = pool->stripes[i].first + perstripe;
+		if (pool->stripes[i].first > numactive)
+			pool->stripes[i].first = numactive;
+		if (pool->stripes[i].last > numactive)
+			pool->stripes[i].last = numactive;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->nextstripe = 0;
+	pool->busy = pool->numthreads;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+
+	life_thread_work(st);
+	while (pool->busy > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+
+	life_state_merge(st);
+	return (numactive);
+}
+#endif /* HAVE_PTHREAD */
+
+
+/*
+ * life_state_sweep() - Age idle clusters and delete those which are empty.
+ *
+ *	Called every LIMIT_SWEEP iterations rather than every iteration
+ *	since idle clusters far outnumber active ones on a typical screen.
+ */
+static
+void
+life_state_sweep(struct life_state *st)
+{
+	struct cell_cluster *cluster, *next;
+
+	for (cluster = TAILQ_FIRST(&st->idle); cluster != NULL;
+	     cluster = next) {
+		next = TAILQ_NEXT(cluster, link);
+
+		if (cluster->dormant < LIMIT_KEEPEMPTY) {
+			cluster->dormant += LIMIT_SWEEP;
+			if (cluster->dormant > LIMIT_KEEPEMPTY)
+				cluster->dormant = LIMIT_KEEPEMPTY;
+			continue;
+		}
+		if (cluster->numcells == 0)
+			life_cluster_delete(st, cluster);
+	}
+}
+
+
+void
+life_state_update(struct life_state *st)
+{
+	struct cell_cluster *cluster, *next, *last;
+	int delta;
+
+	if (st->hashlife != NULL) {
+		life_hashlife_update(st);
+		st->iteration++;
+		return;
+	}
+
+#ifdef HAVE_PTHREAD
+	if (st->pool != NULL) {
+		st->numactive = life_state_update_threaded(st);
+		goto seed;
+	}
+#endif
+
+	/*
+	 * Clusters woken during this loop are added to the end of the active
+	 * list; they are not updated until the next iteration.
+	 */
+	st->numactive = 0;
+	last = TAILQ_LAST(&st->active, cell_cluster_list);
+	for (cluster = TAILQ_FIRST(&st->active); cluster != NULL;
+	     cluster = next) {
+		next = TAILQ_NEXT(cluster, link);
+
+		delta = st->cluster_update(st, cluster, NULL);
+		st->numcells += delta;
+		if (cluster->dormant == 0) {
+			st->counters.births += cluster->births;
+			st->counters.deaths += cluster->births - delta;
+		}
+		if (cluster->wake != 0)
+			life_cluster_wake(st, cluster);
+		if (cluster->dormant >= st->limitupdate)
+			life_cluster_deactivate(st, cluster);
+		st->numactive++;
+
+		if (cluster == last)
+			break;
+	}
+
+#ifdef HAVE_PTHREAD
+seed:
+#endif
+	/* Commit the new generation. */
+	st->parity ^= 1;
+	st->counters.generations++;
+	st->counters.updated += st->numactive;
+	st->counters.clusters += st->numclusters;
+
+	if (st->iteration % LIMIT_SWEEP == 0)
+		life_state_sweep(st);
+
+	/* Try to keep the display at least 6.25% full. */
+	if (!st->nofill && (st->iteration % 256 == 0 ||
+	    st->numvisible * 16 < st->maxclusters))
+		life_pattern_add(st);
+
+	st->iteration++;
+}
+
+
+/*
+ * life_cluster_wakeneighbor() - Wake a neighbor, creating it if necessary.
+ *
+ *	Existing neighbors are reached through the cluster's neighbor
+ *	pointers rather than the cluster table.
+ */
+static __inline
+void
+life_cluster_wakeneighbor(struct life_state *st,
+			  const struct cell_cluster *cluster,
+			  int xoffset, int yoffset)
+{
+	struct cell_cluster *neighbor;
+	int direction;
+
+	/* See the ordering of enum direction. */
+	direction = (yoffset + 1) * 3 + (xoffset + 1);
+	if (direction > NUMDIRECTIONS / 2)
+		direction--;
+
+	if ((neighbor = cluster->neighbor[direction]) != NULL) {
+		neighbor->dormant = 0;
+		life_cluster_activate(st, neighbor);
+		return;
+	}
+	life_cluster_new(st, cluster->clusterX + xoffset,
+			 cluster->clusterY + yoffset);
+}
+
+
+/*
+ * life_cell_birthcolor() - Pick the color of a newborn cell.
+ *
+ *	Calculate color by averaging neighbors' plus some randomness.  The
+ *	color index only increases until wrap-around.  Due to integer
+ *	truncation, the odds of increasing the color are 1/4 (random % 8 must
+ *	be either 6 or 7).  The sum is of the neighbors' colors, less
+ *	CELL_MINALIVE each.
+ *
+ *	The randomness comes from random() unless randstate is non-NULL, in
+ *	which case rand_r() is used so that threads do not contend for (or
+ *	race on) the global generator.
+ */
+static __inline
+cell
+life_cell_birthcolor(const struct life_state * const st, int sum,
+		     unsigned int *randstate)
+{
+	int color;
+	long r;
+
+	r = randstate != NULL ? rand_r(randstate) : random();
+	color = ((sum << 1) + (r % 0x07)) / 6;
+	if (color >= st->colorwrap)
+		color = 0;
+	return (color + CELL_MINALIVE);
+}
+
+
+/*
+ * life_cluster_gather() - Build a padded copy of a cluster's old state.
+ *
+ *	The state buffer is one cell larger than the cluster on each side;
+ *	the padding holds the adjacent edges of the neighboring clusters.
+ */
+static
+void
+life_cluster_gather(const struct life_state *st,
+		    const struct cell_cluster *cluster,
+		    cell state[CLUSTERSIZE + 2][CLUSTERSIZE + 2])
+{
+	const struct cell_cluster *neighbor;
+	const cell (*cells)[CLUSTERSIZE];
+	int idx;
+
+	memset(state, CELL_DEAD, sizeof(state[0]) * (CLUSTERSIZE + 2));
+
+	/*
+	 * First populate the simulation state buffer.  The edges come from
+	 * neighboring clusters.
+	 */
+	if ((neighbor = cluster->neighbor[NORTHWEST]) != NULL) {
+		cells = LIFE_CURGEN(st, neighbor);
+		state[0][0] = cells[CLUSTERSIZE-1][CLUSTERSIZE-1];
+	}
+
+	if ((neighbor = cluster->neighbor[NORTHEAST]) != NULL) {
+		cells = LIFE_CURGEN(st, neighbor);
+		state[0][CLUSTERSIZE+1] = cells[CLUSTERSIZE-1][0];
+	}
+
+	if ((neighbor = cluster->neighbor[SOUTHWEST]) != NULL) {
+		cells = LIFE_CURGEN(st, neighbor);
+		state[CLUSTERSIZE+1][0] = cells[0][CLUSTERSIZE-1];
+	}
+
+	if ((neighbor = cluster->neighbor[SOUTHEAST]) != NULL) {
+		cells = LIFE_CURGEN(st, neighbor);
+		state[CLUSTERSIZE+1][CLUSTERSIZE+1] = cells[0][0];
+	}
+
+	if ((neighbor = cluster->neighbor[NORTH]) != NULL) {
+		cells = LIFE_CURGEN(st, neighbor);
+		memcpy(&state[0][1], &cells[CLUSTERSIZE-1][0],
+		       CLUSTERSIZE * sizeof(cell));
+	}
+
+	if ((neighbor = cluster->neighbor[SOUTH]) != NULL) {
+		cells = LIFE_CURGEN(st, neighbor);
+		memcpy(&state[CLUSTERSIZE + 1][1], &cells[0][0],
+		       CLUSTERSIZE * sizeof(cell));
+	}
+
+	if ((neighbor = cluster->neighbor[WEST]) != NULL) {
+		cells = LIFE_CURGEN(st, neighbor);
+		for (idx = 0; idx < CLUSTERSIZE; idx++)
+			state[idx+1][0] = cells[idx][CLUSTERSIZE-1];
+	}
+
+	if ((neighbor = cluster->neighbor[EAST]) != NULL) {
+		cells = LIFE_CURGEN(st, neighbor);
+		for (idx = 0; idx < CLUSTERSIZE; idx++)
+			state[idx+1][CLUSTERSIZE+1] = cells[idx][0];
+	}
+
+	/* Copy the middle from the current cluster's old cell state. */
+	cells = LIFE_CURGEN(st, cluster);
+	for (idx = 0; idx < CLUSTERSIZE; idx++) {
+		memcpy(&state[idx+1][1], &cells[idx][0],
+		       CLUSTERSIZE * sizeof(cell));
+	}
+}
+
+
+/*
+ * life_cluster_prepare() - Bring a cluster's next generation up to date.
+ *
+ *	Called by the kernels before they write any changed cells into the
+ *	next generation buffer.
+ */
+static __inline
+void
+life_cluster_prepare(const struct life_state *st, struct cell_cluster *cluster)
+{
+
+	if (cluster->dormant == 0)
+		memcpy(LIFE_NEXTGEN(st, cluster), LIFE_CURGEN(st, cluster),
+		       sizeof(cluster->cells[0]));
+}
+
+
+/*
+ * life_cluster_update_bytewise() - Calculate the next generation of a cluster.
+ *
+ *	This is the original kernel: it builds a padded copy of the cluster's
+ *	old state and then examines each cell's 3x3 neighborhood in turn.
+ *	It is kept for comparison with life_cluster_update_swar().
+ *
+ *	All kernels only modify the given cluster; neighbors which need
+ *	waking are recorded in cluster->wake for the caller to act upon.
+ *	They return the change in the number of live cells.
+ */
+int
+life_cluster_update_bytewise(struct life_state *st,
+			     struct cell_cluster *cluster,
+			     unsigned int *randstate)
+{
+	cell state[CLUSTERSIZE + 2][CLUSTERSIZE + 2];
+	cell (*nextgen)[CLUSTERSIZE] = LIFE_NEXTGEN(st, cluster);
+	int cellX, cellY;
+	int x, y, count;
+	int cellval;
+	clusterrow changemapX, changemapY;
+	int deaths, births;
+	int sum;
+
+	changemapX = changemapY = 0;
+	deaths = births = 0;
+	life_cluster_gather(st, cluster, state);
+	life_cluster_prepare(st, cluster);
+
+	/*
+	 * Now, we can calculate the current state for this cluster.
+	 */
+	for (cellY = 0; cellY < CLUSTERSIZE; cellY++) {
+		for (cellX = 0; cellX < CLUSTERSIZE; cellX++) {
+
+			cellval = state[cellY + 1][cellX + 1];
+			count = sum = 0;
+
+			/*
+			 * Examine each neighbor; offset by 1 due to padding in
+			 * local state buffer.
+			 */
+			for (y = cellY; y <= cellY + 2; y++) {
+				for (x = cellX; x <= cellX + 2; x++) {
+					if (state[y][x] != CELL_DEAD) {
+						sum += state[y][x] - CELL_MINALIVE;
+						count++;
+					}
+				}
+			}
+
+			if (cellval != CELL_DEAD) {
+				/*
+				 * Survival of existing cell unless it has
+				 * reached its maximum age.
+				 * Note that count includes the cell itself.
+				 */
+				if ((count == 3 || count == 4) &&
+				    (st->cellmaxage == 0 ||
+				     ++cluster->cellage[cellY][cellX] < st->cellmaxage))
+					continue;
+
+				/* Otherwise, death. */
+				nextgen[cellY][cellX] = CELL_DEAD;
+				if (cluster->cellage != NULL)
+					cluster->cellage[cellY][cellX] = 0;
+				deaths++;
+
+				changemapX |= (clusterrow)1 << cellX;
+				changemapY |= (clusterrow)1 << cellY;
+
+				continue;
+			}
+
+			if (count != 3)
+				continue;
+
+			/* Cell birth. */
+			nextgen[cellY][cellX] =
+			    life_cell_birthcolor(st, sum, randstate);
+			births++;
+
+			changemapX |= (clusterrow)1 << cellX;
+			changemapY |= (clusterrow)1 << cellY;
+		}
+	}
+
+	if (births == 0 && deaths == 0) {
+		/* Dormant cluster. */
+		cluster->dormant++;
+		return (0);
+	}
+
+	cluster->births = births;
+	cluster->numcells += births - deaths;
+#if 0
+	fprintf(stderr, "[%p] births = %d, deaths = %d, numcells = %d\n",
+			cluster, births, deaths, cluster->numcells);
+#endif
+
+	assert(cluster->numcells >= 0);
+	cluster->dormant = 0;
+
+	life_cluster_markwake(st, cluster, changemapX, changemapY);
+	return (births - deaths);
+}
+
+
+/*
+ * Helpers for the bit-parallel kernel.  A cluster's alive/dead state is
+ * packed into CLUSTERMAP_WORDS clustermaps of CLUSTERMAP_ROWS rows each, with
+ * cell (x, y) at bit ((y % CLUSTERMAP_ROWS) * CLUSTERSIZE + x) of word
+ * (y / CLUSTERMAP_ROWS).  Shifting a word by CLUSTERSIZE moves a whole row
+ * and shifting by 1 moves each cell to its neighbor's place in the same row;
+ * the WESTCOL and EASTCOL masks clear the bits which cross into the next
+ * row.  With a CLUSTERSIZE of 8 the whole cluster fits in one word; with 64
+ * each word is a single row and there is nothing to shift between rows.
+ */
+typedef uint64_t clustermap;
+#define	CLUSTERMAP_BITS		64
+#define	CLUSTERMAP_ROWS		(CLUSTERMAP_BITS / CLUSTERSIZE)
+#define	CLUSTERMAP_WORDS	(CLUSTERSIZE / CLUSTERMAP_ROWS)
+#define	CLUSTERMAP_WESTCOL	(~(clustermap)0 / CLUSTERROW_ALL)
+#define	CLUSTERMAP_EASTCOL	(CLUSTERMAP_WESTCOL << (CLUSTERSIZE - 1))
+
+#if CLUSTERMAP_ROWS > 1
+# define CLUSTERMAP_ROWDOWN(map)	((map) << CLUSTERSIZE)
+# define CLUSTERMAP_ROWUP(map)		((map) >> CLUSTERSIZE)
+#else
+# define CLUSTERMAP_ROWDOWN(map)	((clustermap)0)
+# define CLUSTERMAP_ROWUP(map)		((clustermap)0)
+#endif
+#define	CLUSTERMAP_FIRSTROW(map)	((clusterrow)(map))
+#define	CLUSTERMAP_LASTROW(map)						\
+	((clusterrow)((map) >> (CLUSTERMAP_BITS - CLUSTERSIZE)))
+#define	CLUSTERMAP_TOLASTROW(row)					\
+	((clustermap)(row) << (CLUSTERMAP_BITS - CLUSTERSIZE))
+
+/* Get row y, or OR bits into row y starting at column x. */
+#define	CLUSTERMAP_GETROW(map, y)					\
+	((clusterrow)((map)[(y) / CLUSTERMAP_ROWS] >>			\
+		      (((y) % CLUSTERMAP_ROWS) * CLUSTERSIZE)))
+#define	CLUSTERMAP_SETBITS(map, x, y, bits)				\
+	((map)[(y) / CLUSTERMAP_ROWS] |= (clustermap)(bits) <<		\
+	    (((y) % CLUSTERMAP_ROWS) * CLUSTERSIZE + (x)))
+
+static __inline
+clusterrow
+life_row_pack(const cell *row)
+{
+	clusterrow bits;
+	int x;
+
+	bits = 0;
+	for (x = 0; x < CLUSTERSIZE; x++) {
+		if (row[x] != CELL_DEAD)
+			bits |= (clusterrow)1 << x;
+	}
+	return (bits);
+}
+
+
+/*
+ * life_column_pack() - Pack a column of a cluster into clustermaps.
+ *
+ *	The cells of the given column are placed in column x of map.
+ */
+static __inline
+void
+life_column_pack(const struct life_state *st,
+		 const struct cell_cluster *cluster,
+		 int column, int x, clustermap map[CLUSTERMAP_WORDS])
+{
+	int y;
+
+	memset(map, 0, sizeof(clustermap) * CLUSTERMAP_WORDS);
+	for (y = 0; y < CLUSTERSIZE; y++) {
+		if (LIFE_CURGEN(st, cluster)[y][column] != CELL_DEAD)
+			CLUSTERMAP_SETBITS(map, x, y, 1);
+	}
+}
+
+
+/*
+ * life_cluster_oldcell() - Look up a cell in the previous generation.
+ *
+ *	The coordinates may be up to 1 cell outside of the cluster, in which
+ *	case the cell is looked up in the appropriate neighboring cluster.
+ */
+static __inline
+cell
+life_cluster_oldcell(const struct life_state *st,
+		     const struct cell_cluster *cluster, int x, int y)
+{
+	const struct cell_cluster *neighbor;
+	int direction;
+
+	if (x >= 0 && x < CLUSTERSIZE && y >= 0 && y < CLUSTERSIZE)
+		return (LIFE_CURGEN(st, cluster)[y][x]);
+
+	direction = (y < 0 ? 0 : y < CLUSTERSIZE ? 3 : 6) +
+		    (x < 0 ? 0 : x < CLUSTERSIZE ? 1 : 2);
+	if (direction > WEST)
+		direction--;		/* Skip over the cluster itself. */
+
+	neighbor = cluster->neighbor[direction];
+	if (neighbor == NULL)
+		return (CELL_DEAD);
+	return (LIFE_CURGEN(st, neighbor)[(y + CLUSTERSIZE) % CLUSTERSIZE]
+					  [(x + CLUSTERSIZE) % CLUSTERSIZE]);
+}
+
+
+/*
+ * life_cluster_colorsum() - Sum the colors of a cell's live neighbors.
+ *
+ *	Each live neighbor contributes its color less CELL_MINALIVE, as
+ *	expected by life_cell_birthcolor().
+ */
+static __inline
+int
+life_cluster_colorsum(const struct life_state *st,
+		      const struct cell_cluster *cluster, int cellX, int cellY)
+{
+	cell c;
+	int x, y;
+	int sum;
+
+	sum = 0;
+	for (y = cellY - 1; y <= cellY + 1; y++) {
+		for (x = cellX - 1; x <= cellX + 1; x++) {
+			c = life_cluster_oldcell(st, cluster, x, y);
+			if (c != CELL_DEAD)
+				sum += c - CELL_MINALIVE;
+		}
+	}
+	return (sum);
+}
+
+
+/*
+ * life_cluster_commit() - Apply a generation computed as clustermaps.
+ *
+ *	Births are processed in the same order as in the bytewise kernel so
+ *	that the random colors match.  If sums is NULL, the color sum for
+ *	each birth is calculated from the neighbors' old state.
+ */
+static
+int
+life_cluster_commit(struct life_state *st, struct cell_cluster *cluster,
+		    const clustermap born[CLUSTERMAP_WORDS],
+		    clustermap died[CLUSTERMAP_WORDS],
+		    const clustermap survived[CLUSTERMAP_WORDS],
+		    const short sums[CLUSTERSIZE][CLUSTERSIZE],
+		    unsigned int *randstate)
+{
+	clusterrow changemapX, changemapY;
+	clusterrow row;
+	clustermap changed;
+	int cellX, cellY;
+	int deaths, births;
+	int sum;
+	int word;
+
+	life_cluster_prepare(st, cluster);
+
+	/* Survivors die if they have reached their maximum age. */
+	if (st->cellmaxage != 0) {
+		for (cellY = 0; cellY < CLUSTERSIZE; cellY++) {
+			row = CLUSTERMAP_GETROW(survived, cellY);
+			for (cellX = 0; row != 0; cellX++, row >>= 1) {
+				if ((row & 1) &&
+				    ++cluster->cellage[cellY][cellX] >=
+				    st->cellmaxage)
+					CLUSTERMAP_SETBITS(died, cellX, cellY,
+							   1);
+			}
+		}
+	}
+
+	changed = 0;
+	for (word = 0; word < CLUSTERMAP_WORDS; word++)
+		changed |= born[word] | died[word];
+	if (changed == 0) {
+		/* Dormant cluster. */
+		cluster->dormant++;
+		return (0);
+	}
+
+	changemapX = changemapY = 0;
+	deaths = births = 0;
+	for (cellY = 0; cellY < CLUSTERSIZE; cellY++) {
+		row = CLUSTERMAP_GETROW(died, cellY);
+		if (row == 0)
+			continue;
+		changemapX |= row;
+		changemapY |= (clusterrow)1 << cellY;
+
+		for (cellX = 0; row != 0; cellX++, row >>= 1) {
+			if (!(row & 1))
+				continue;
+			LIFE_NEXTGEN(st, cluster)[cellY][cellX] = CELL_DEAD;
+			if (cluster->cellage != NULL)
+				cluster->cellage[cellY][cellX] = 0;
+			deaths++;
+		}
+	}
+
+	for (cellY = 0; cellY < CLUSTERSIZE; cellY++) {
+		row = CLUSTERMAP_GETROW(born, cellY);
+		if (row == 0)
+			continue;
+		changemapX |= row;
+		changemapY |= (clusterrow)1 << cellY;
+
+		for (cellX = 0; row != 0; cellX++, row >>= 1) {
+			if (!(row & 1))
+				continue;
+
+			if (sums != NULL)
+				sum = sums[cellY][cellX];
+			else
+				sum = life_cluster_colorsum(st, cluster,
+							    cellX, cellY);
+
+			LIFE_NEXTGEN(st, cluster)[cellY][cellX] =
+			    life_cell_birthcolor(st, sum, randstate);
+			births++;
+		}
+	}
+
+	cluster->births = births;
+	cluster->numcells += births - deaths;
+
+	assert(cluster->numcells >= 0);
+	cluster->dormant = 0;
+
+	life_cluster_markwake(st, cluster, changemapX, changemapY);
+	return (births - deaths);
+}
+
+
+/*
+ * life_cluster_update_swar() - Calculate the next generation of a cluster.
+ *
+ *	Bit-parallel version of life_cluster_update_bytewise().  The cluster
+ *	and the adjacent edges of its neighbors are packed into clustermaps
+ *	and the neighbor counts for all cells in each word are computed at
+ *	once with a bit-sliced adder.  Colors are only calculated for the
+ *	cells which are born, in the same order as the bytewise kernel so
+ *	that both consume random() identically.
+ */
+int
+life_cluster_update_swar(struct life_state *st, struct cell_cluster *cluster,
+			 unsigned int *randstate)
+{
+	const struct cell_cluster *neighbor;
+	clustermap alive[CLUSTERMAP_WORDS];
+	clustermap west[CLUSTERMAP_WORDS], east[CLUSTERMAP_WORDS];
+	clustermap born[CLUSTERMAP_WORDS], died[CLUSTERMAP_WORDS];
+	clustermap survived[CLUSTERMAP_WORDS];
+	clustermap up, down, westup, westdown, eastup, eastdown;
+	clustermap nbr[NUMDIRECTIONS];
+	clustermap sum0, sum1, sum4, carry0, twoorthree;
+	clusterrow north, south;
+	clusterrow northwest, northeast, southwest, southeast;
+	clusterrow above, below;
+	int cellY;
+	int word;
+	int idx;
+
+	memset(alive, 0, sizeof(alive));
+	for (cellY = 0; cellY < CLUSTERSIZE; cellY++) {
+		CLUSTERMAP_SETBITS(alive, 0, cellY,
+		    life_row_pack(LIFE_CURGEN(st, cluster)[cellY]));
+	}
+
+	/*
+	 * Gather the edges of the neighboring clusters.  The north and south
+	 * rows and the corners are kept as rows (the corners already in the
+	 * column they will be needed in) until they are shifted in below;
+	 * the west and east columns are packed alongside the cluster's first
+	 * and last columns.
+	 */
+	north = south = 0;
+	northwest = northeast = southwest = southeast = 0;
+
+	if ((neighbor = cluster->neighbor[NORTH]) != NULL)
+		north = life_row_pack(LIFE_CURGEN(st, neighbor)[CLUSTERSIZE-1]);
+	if ((neighbor = cluster->neighbor[SOUTH]) != NULL)
+		south = life_row_pack(LIFE_CURGEN(st, neighbor)[0]);
+
+	if ((neighbor = cluster->neighbor[WEST]) != NULL)
+		life_column_pack(st, neighbor, CLUSTERSIZE-1, 0, west);
+	else
+		memset(west, 0, sizeof(west));
+	if ((neighbor = cluster->neighbor[EAST]) != NULL)
+		life_column_pack(st, neighbor, 0, CLUSTERSIZE-1, east);
+	else
+		memset(east, 0, sizeof(east));
+
+	if ((neighbor = cluster->neighbor[NORTHWEST]) != NULL &&
+	    LIFE_CURGEN(st, neighbor)[CLUSTERSIZE-1][CLUSTERSIZE-1] !=
+	    CELL_DEAD)
+		northwest = 1;
+	if ((neighbor = cluster->neighbor[NORTHEAST]) != NULL &&
+	    LIFE_CURGEN(st, neighbor)[CLUSTERSIZE-1][0] != CELL_DEAD)
+		northeast = (clusterrow)1 << (CLUSTERSIZE-1);
+	if ((neighbor = cluster->neighbor[SOUTHWEST]) != NULL &&
+	    LIFE_CURGEN(st, neighbor)[0][CLUSTERSIZE-1] != CELL_DEAD)
+		southwest = 1;
+	if ((neighbor = cluster->neighbor[SOUTHEAST]) != NULL &&
+	    LIFE_CURGEN(st, neighbor)[0][0] != CELL_DEAD)
+		southeast = (clusterrow)1 << (CLUSTERSIZE-1);
+
+	for (word = 0; word < CLUSTERMAP_WORDS; word++) {
+		/*
+		 * Shift the rows above and below each cell into place,
+		 * bringing in the adjacent row of the previous and next
+		 * words, or the north and south edges.
+		 */
+		above = word > 0 ? CLUSTERMAP_LASTROW(alive[word - 1]) : north;
+		below = word < CLUSTERMAP_WORDS - 1 ?
+			CLUSTERMAP_FIRSTROW(alive[word + 1]) : south;
+		up = CLUSTERMAP_ROWDOWN(alive[word]) | above;
+		down = CLUSTERMAP_ROWUP(alive[word]) |
+		       CLUSTERMAP_TOLASTROW(below);
+
+		above = word > 0 ? CLUSTERMAP_LASTROW(west[word - 1]) :
+			northwest;
+		below = word < CLUSTERMAP_WORDS - 1 ?
+			CLUSTERMAP_FIRSTROW(west[word + 1]) : southwest;
+		westup = CLUSTERMAP_ROWDOWN(west[word]) | above;
+		westdown = CLUSTERMAP_ROWUP(west[word]) |
+			   CLUSTERMAP_TOLASTROW(below);
+
+		above = word > 0 ? CLUSTERMAP_LASTROW(east[word - 1]) :
+			northeast;
+		below = word < CLUSTERMAP_WORDS - 1 ?
+			CLUSTERMAP_FIRSTROW(east[word + 1]) : southeast;
+		eastup = CLUSTERMAP_ROWDOWN(east[word]) | above;
+		eastdown = CLUSTERMAP_ROWUP(east[word]) |
+			   CLUSTERMAP_TOLASTROW(below);
+
+		/*
+		 * Build one map per direction in which bit (x, y) is set if
+		 * the neighbor of cell (x, y) in that direction is alive.
+		 */
+		nbr[NORTHWEST] = ((up << 1) & ~CLUSTERMAP_WESTCOL) | westup;
+		nbr[NORTH] = up;
+		nbr[NORTHEAST] = ((up >> 1) & ~CLUSTERMAP_EASTCOL) | eastup;
+		nbr[WEST] = ((alive[word] << 1) & ~CLUSTERMAP_WESTCOL) |
+			    west[word];
+		nbr[EAST] = ((alive[word] >> 1) & ~CLUSTERMAP_EASTCOL) |
+			    east[word];
+		nbr[SOUTHWEST] = ((down << 1) & ~CLUSTERMAP_WESTCOL) |
+				 westdown;
+		nbr[SOUTH] = down;
+		nbr[SOUTHEAST] = ((down >> 1) & ~CLUSTERMAP_EASTCOL) |
+				 eastdown;
+
+		/*
+		 * Count the neighbors of all cells at once.  sum1:sum0 holds
+		 * the count modulo 4 and sum4 is set once the count reaches
+		 * 4; we never need to distinguish between counts of 4 or
+		 * more.
+		 */
+		sum0 = sum1 = sum4 = 0;
+		for (idx = 0; idx < NUMDIRECTIONS; idx++) {
+			carry0 = sum0 & nbr[idx];
+			sum0 ^= nbr[idx];
+			sum4 |= sum1 & carry0;
+			sum1 ^= carry0;
+		}
+		twoorthree = sum1 & ~sum4;
+
+		survived[word] = alive[word] & twoorthree;
+		died[word] = alive[word] & ~twoorthree;
+		born[word] = ~alive[word] & twoorthree & sum0;
+	}
+
+	return (life_cluster_commit(st, cluster, born, died, survived, NULL,
+				    randstate));
+}
+
+
+#ifdef LIFE_SIMD
+/*
+ * SIMD kernels.  These compute the neighbor counts and color sums for all
+ * cells from the same padded state buffer as the bytewise kernel, 8 (SSE2)
+ * or 16 (AVX2) cells at a time in 16-bit lanes, and then hand the results
+ * to life_cluster_commit().  Cells are taken in row-major order so with a
+ * CLUSTERSIZE of 8, AVX2 handles two rows at once.  The counts include the
+ * cell itself, as in the bytewise kernel; a cell which is born is dead, so
+ * the sum only ever includes its neighbors.
+ */
+__attribute__((target("sse2")))
+static __inline
+void
+life_simd_masks(__m128i center, __m128i count, int x, int y,
+		clustermap born[CLUSTERMAP_WORDS],
+		clustermap died[CLUSTERMAP_WORDS],
+		clustermap survived[CLUSTERMAP_WORDS])
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i dead, three, four;
+	unsigned int alive, twoorthree;
+
+	dead = _mm_cmpeq_epi16(center, zero);
+	three = _mm_cmpeq_epi16(count, _mm_set1_epi16(3));
+	four = _mm_cmpeq_epi16(count, _mm_set1_epi16(4));
+
+	alive = ~_mm_movemask_epi8(_mm_packs_epi16(dead, zero)) & 0xff;
+	twoorthree = _mm_movemask_epi8(_mm_packs_epi16(
+	    _mm_or_si128(three, four), zero));
+
+	CLUSTERMAP_SETBITS(born, x, y, _mm_movemask_epi8(_mm_packs_epi16(
+	    _mm_and_si128(dead, three), zero)));
+	CLUSTERMAP_SETBITS(survived, x, y, alive & twoorthree);
+	CLUSTERMAP_SETBITS(died, x, y, alive & ~twoorthree);
+}
+
+
+__attribute__((target("sse2")))
+int
+life_cluster_update_sse2(struct life_state *st, struct cell_cluster *cluster,
+			 unsigned int *randstate)
+{
+	cell state[CLUSTERSIZE + 2][CLUSTERSIZE + 2];
+	short sums[CLUSTERSIZE][CLUSTERSIZE];
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	__m128i v, dead, count, sum, center;
+	clustermap born[CLUSTERMAP_WORDS], died[CLUSTERMAP_WORDS];
+	clustermap survived[CLUSTERMAP_WORDS];
+	int cellX, cellY;
+	int x, y;
+
+	life_cluster_gather(st, cluster, state);
+
+	memset(born, 0, sizeof(born));
+	memset(died, 0, sizeof(died));
+	memset(survived, 0, sizeof(survived));
+	for (cellY = 0; cellY < CLUSTERSIZE; cellY++) {
+		for (cellX = 0; cellX < CLUSTERSIZE; cellX += 8) {
+			count = sum = zero;
+			for (y = cellY; y <= cellY + 2; y++) {
+				for (x = cellX; x <= cellX + 2; x++) {
+					v = _mm_unpacklo_epi8(_mm_loadl_epi64(
+					    (const __m128i *)&state[y][x]),
+					    zero);
+					dead = _mm_cmpeq_epi16(v, zero);
+					count = _mm_add_epi16(count,
+					    _mm_andnot_si128(dead, one));
+					sum = _mm_add_epi16(sum,
+					    _mm_andnot_si128(dead,
+					    _mm_sub_epi16(v, one)));
+				}
+			}
+			_mm_storeu_si128((__m128i *)&sums[cellY][cellX], sum);
+
+			center = _mm_unpacklo_epi8(_mm_loadl_epi64(
+			    (const __m128i *)&state[cellY + 1][cellX + 1]),
+			    zero);
+			life_simd_masks(center, count, cellX, cellY,
+					born, died, survived);
+		}
+	}
+
+	return (life_cluster_commit(st, cluster, born, died, survived,
+				    (const short (*)[CLUSTERSIZE])sums,
+				    randstate));
+}
+
+
+__attribute__((target("avx2")))
+static __inline
+__m256i
+life_simd_load16(const cell *first, const cell *second)
+{
+
+	return (_mm256_cvtepu8_epi16(_mm_unpacklo_epi64(
+	    _mm_loadl_epi64((const __m128i *)first),
+	    _mm_loadl_epi64((const __m128i *)second))));
+}
+
+
+__attribute__((target("avx2")))
+int
+life_cluster_update_avx2(struct life_state *st, struct cell_cluster *cluster,
+			 unsigned int *randstate)
+{
+	cell state[CLUSTERSIZE + 2][CLUSTERSIZE + 2];
+	short sums[CLUSTERSIZE][CLUSTERSIZE];
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi16(1);
+	__m256i v, dead, count, sum, center;
+	clustermap born[CLUSTERMAP_WORDS], died[CLUSTERMAP_WORDS];
+	clustermap survived[CLUSTERMAP_WORDS];
+	int x0, y0, x1, y1;
+	int dx, dy;
+	int idx;
+
+	life_cluster_gather(st, cluster, state);
+
+	memset(born, 0, sizeof(born));
+	memset(died, 0, sizeof(died));
+	memset(survived, 0, sizeof(survived));
+
+	/* Each pass handles cells (x0, y0) and (x1, y1) onwards, 8 each. */
+	for (idx = 0; idx < CLUSTERSIZE * CLUSTERSIZE; idx += 16) {
+		x0 = idx % CLUSTERSIZE;
+		y0 = idx / CLUSTERSIZE;
+		x1 = (idx + 8) % CLUSTERSIZE;
+		y1 = (idx + 8) / CLUSTERSIZE;
+
+		count = sum = zero;
+		for (dy = 0; dy <= 2; dy++) {
+			for (dx = 0; dx <= 2; dx++) {
+				v = life_simd_load16(&state[y0 + dy][x0 + dx],
+						     &state[y1 + dy][x1 + dx]);
+				dead = _mm256_cmpeq_epi16(v, zero);
+				count = _mm256_add_epi16(count,
+				    _mm256_andnot_si256(dead, one));
+				sum = _mm256_add_epi16(sum,
+				    _mm256_andnot_si256(dead,
+				    _mm256_sub_epi16(v, one)));
+			}
+		}
+		_mm256_storeu_si256((__m256i *)&sums[y0][x0], sum);
+
+		center = life_simd_load16(&state[y0 + 1][x0 + 1],
+					  &state[y1 + 1][x1 + 1]);
+		life_simd_masks(_mm256_castsi256_si128(center),
+				_mm256_castsi256_si128(count), x0, y0,
+				born, died, survived);
+		life_simd_masks(_mm256_extracti128_si256(center, 1),
+				_mm256_extracti128_si256(count, 1), x1, y1,
+				born, died, survived);
+	}
+
+	return (life_cluster_commit(st, cluster, born, died, survived,
+				    (const short (*)[CLUSTERSIZE])sums,
+				    randstate));
+}
+#endif /* LIFE_SIMD */
+
+
+/*
+ * life_cluster_update_simd() - Select the best SIMD kernel for this CPU.
+ *
+ *	Falls back to the bytewise kernel if the CPU (or compiler) supports
+ *	neither SSE2 nor AVX2.
+ */
+static
+int
+(*life_cluster_update_simd(void))(struct life_state *, struct cell_cluster *,
+				  unsigned int *)
+{
+
+#ifdef LIFE_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return (life_cluster_update_avx2);
+	if (__builtin_cpu_supports("sse2"))
+		return (life_cluster_update_sse2);
+#endif
+	return (life_cluster_update_bytewise);
+}
+
+
+/*
+ * life_cluster_markwake() - Record neighbors affected by edge changes.
+ *
+ *	If there were any changes along the edges, the adjacent neighbor
+ *	clusters need to be woken because it will affect them too next
+ *	iteration.  This isn't just an optimization: since
+ *	life_state_update() only scans non-dormant clusters, if we didn't
+ *	wake them then we would never detect spill-over at all.
+ *
+ *	The diagonal neighbors only need waking if the corner cell itself
+ *	changed, whether by birth or by death.
+ *
+ *	The kernels only mark which neighbors to wake so that they never
+ *	modify anything but the cluster they are given; the wake-up itself
+ *	is done by life_cluster_wake().
+ */
+#define	LIFE_CELL_CHANGED(st, cluster, x, y)				\
+	(LIFE_NEXTGEN(st, cluster)[y][x] != LIFE_CURGEN(st, cluster)[y][x])
+
+void
+life_cluster_markwake(const struct life_state *st, struct cell_cluster *cluster,
+		      clusterrow changemapX, clusterrow changemapY)
+{
+	unsigned char wake = 0;
+
+	if (changemapY & ((clusterrow)1 << 0)) {
+		if (LIFE_CELL_CHANGED(st, cluster, 0, 0))
+			wake |= 1 << NORTHWEST;
+		wake |= 1 << NORTH;
+		if (LIFE_CELL_CHANGED(st, cluster, CLUSTERSIZE-1, 0))
+			wake |= 1 << NORTHEAST;
+	}
+	if (changemapX & ((clusterrow)1 << 0))
+		wake |= 1 << WEST;
+	if (changemapX & ((clusterrow)1 << (CLUSTERSIZE-1)))
+		wake |= 1 << EAST;
+	if (changemapY & ((clusterrow)1 << (CLUSTERSIZE-1))) {
+		if (LIFE_CELL_CHANGED(st, cluster, 0, CLUSTERSIZE-1))
+			wake |= 1 << SOUTHWEST;
+		wake |= 1 << SOUTH;
+		if (LIFE_CELL_CHANGED(st, cluster,
+				      CLUSTERSIZE-1, CLUSTERSIZE-1))
+			wake |= 1 << SOUTHEAST;
+	}
+	cluster->wake = wake;
+}
+
+
+/*
+ * life_cluster_wake() - Wake the neighbors marked by life_cluster_markwake().
+ *
+ *	Neighboring clusters which do not exist yet are created.
+ */
+void
+life_cluster_wake(struct life_state *st, struct cell_cluster *cluster)
+{
+	int direction;
+
+	for (direction = 0; direction < NUMDIRECTIONS; direction++) {
+		if (cluster->wake & (1 << direction)) {
+			life_cluster_wakeneighbor(st, cluster,
+			    direction_offset[direction].x,
+			    direction_offset[direction].y);
+		}
+	}
+	cluster->wake = 0;
+}
+
+
+/*
+ * life_pool_alloc() - Allocate a zeroed cluster from the cluster pool.
+ *
+ *	Clusters on the free list are reused first, then the unused tail of
+ *	the newest chunk; a new chunk is only allocated when both run out.
+ *	If cells age, each chunk also gets a side table of cell ages with one
+ *	entry per cluster, which stays with the cluster when it is reused;
+ *	the same goes for the cells as last drawn, if they are kept.
+ */
+struct cell_cluster *
+life_pool_alloc(struct life_state *st)
+{
+	struct cluster_pool *pool = &st->clusterpool;
+	struct cluster_chunk *chunk;
+	struct cell_cluster *cluster;
+	unsigned char (*cellage)[CLUSTERSIZE];
+	cell (*drawn)[CLUSTERSIZE];
+	size_t pagesize;
+
+	if ((cluster = pool->freelist) != NULL) {
+		pool->freelist = cluster->neighbor[0];
+		pool->numfree--;
+		cellage = cluster->cellage;
+		drawn = cluster->drawn;
+	} else {
+		chunk = pool->chunks;
+		if (chunk == NULL || chunk->numcarved == chunk->numclusters) {
+			pagesize = sysconf(_SC_PAGESIZE);
+			if (pool->chunksize == 0) {
+				pool->chunksize = sizeof(*chunk) +
+				    sizeof(chunk->clusters[0]);
+				if (pool->chunksize < LIFE_POOLCHUNK)
+					pool->chunksize = LIFE_POOLCHUNK;
+				pool->chunksize = (pool->chunksize +
+				    pagesize - 1) / pagesize * pagesize;
+			}
+			if (posix_memalign((void **)&chunk, pagesize,
+					   pool->chunksize) != 0)
+				exit(1);
+			chunk->numclusters = (pool->chunksize -
+			    sizeof(*chunk)) / sizeof(chunk->clusters[0]);
+			chunk->numcarved = 0;
+			chunk->cellage = NULL;
+			if (st->cellmaxage != 0) {
+				chunk->cellage = malloc(chunk->numclusters *
+				    sizeof(chunk->cellage[0]));
+				if (chunk->cellage == NULL)
+					exit(1);
+			}
+			chunk->drawn = NULL;
+			if (st->gensperdraw > 1) {
+				chunk->drawn = malloc(chunk->numclusters *
+				    sizeof(chunk->drawn[0]));
+				if (chunk->drawn == NULL)
+					exit(1);
+			}
+			chunk->next = pool->chunks;
+			pool->chunks = chunk;
+			pool->numchunks++;
+		}
+		cellage = NULL;
+		if (chunk->cellage != NULL)
+			cellage = chunk->cellage[chunk->numcarved];
+		drawn = NULL;
+		if (chunk->drawn != NULL)
+			drawn = chunk->drawn[chunk->numcarved];
+		cluster = &chunk->clusters[chunk->numcarved++];
+	}
+
+	memset(cluster, 0, sizeof(*cluster));
+	if (cellage != NULL) {
+		memset(cellage, 0, sizeof(cellage[0]) * CLUSTERSIZE);
+		cluster->cellage = cellage;
+	}
+	if (drawn != NULL) {
+		memset(drawn, CELL_DEAD, sizeof(drawn[0]) * CLUSTERSIZE);
+		cluster->drawn = drawn;
+	}
+	pool->numlive++;
+	return (cluster);
+}
+
+
+/*
+ * life_pool_release() - Return a cluster to the cluster pool.
+ */
+void
+life_pool_release(struct life_state *st, struct cell_cluster *cluster)
+{
+	struct cluster_pool *pool = &st->clusterpool;
+
+	cluster->neighbor[0] = pool->freelist;
+	pool->freelist = cluster;
+	pool->numfree++;
+	pool->numlive--;
+}
+
+
+/*
+ * life_pool_free() - Release all clusters at once.
+ */
+void
+life_pool_free(struct life_state *st)
+{
+	struct cluster_pool *pool = &st->clusterpool;
+	struct cluster_chunk *chunk;
+
+	while ((chunk = pool->chunks) != NULL) {
+		pool->chunks = chunk->next;
+		free(chunk->cellage);
+		free(chunk->drawn);
+		free(chunk);
+	}
+	pool->freelist = NULL;
+	pool->numchunks = pool->numlive = pool->numfree = 0;
+}
+
+
+/*
+ * life_cluster_hash() - Hash cluster coordinates to a cluster table slot.
+ */
+static __inline
+unsigned int
+life_cluster_hash(const struct life_state * const st,
+		  int clusterX, int clusterY)
+{
+	unsigned int h;
+
+	h = ((unsigned int)clusterX * 0x9e3779b1U) ^
+	    ((unsigned int)clusterY * 0x85ebca77U);
+	h ^= h >> 16;
+	return (h & st->clustermask);
+}
+
+
+/*
+ * life_cluster_lookup() - Find the cluster at the given coordinates.
+ *
+ *	The coordinates must already be wrapped.  Returns NULL if there is
+ *	no cluster there.
+ */
+struct cell_cluster *
+life_cluster_lookup(const struct life_state * const st,
+		    int clusterX, int clusterY)
+{
+	struct cell_cluster *cluster;
+	unsigned int slot;
+
+	slot = life_cluster_hash(st, clusterX, clusterY);
+	while ((cluster = st->clustertable[slot]) != NULL) {
+		if (cluster->clusterX == clusterX &&
+		    cluster->clusterY == clusterY)
+			return (cluster);
+		slot = (slot + 1) & st->clustermask;
+	}
+	return (NULL);
+}
+
+
+/*
+ * life_table_insert() - Add a cluster to the cluster table.
+ *
+ *	The table is doubled whenever it would become more than half full,
+ *	which keeps probe sequences short.
+ */
+static
+void
+life_table_insert(struct life_state *st, struct cell_cluster *cluster)
+{
+	struct cell_cluster **oldtable;
+	unsigned int oldsize;
+	unsigned int slot, i;
+
+	if ((unsigned int)(st->numclusters + 1) * 2 > st->clustermask + 1) {
+		oldtable = st->clustertable;
+		oldsize = st->clustermask + 1;
+		st->clustertable = calloc(oldsize * 2,
+					  sizeof(*st->clustertable));
+		if (st->clustertable == NULL)
+			exit(1);
+		st->clustermask = (oldsize * 2) - 1;
+
+		for (i = 0; i < oldsize; i++) {
+			if (oldtable[i] != NULL)
+				life_table_insert(st, oldtable[i]);
+		}
+		free(oldtable);
+	}
+
+	slot = life_cluster_hash(st, cluster->clusterX, cluster->clusterY);
+	while (st->clustertable[slot] != NULL)
+		slot = (slot + 1) & st->clustermask;
+	st->clustertable[slot] = cluster;
+}
+
+
+/*
+ * life_table_remove() - Remove a cluster from the cluster table.
+ *
+ *	Rather than leaving a tombstone, later clusters in the same probe
+ *	sequence are shifted back to fill the hole.
+ */
+static
+void
+life_table_remove(struct life_state *st, struct cell_cluster *cluster)
+{
+	struct cell_cluster *other;
+	unsigned int mask = st->clustermask;
+	unsigned int slot, hole, home;
+
+	slot = life_cluster_hash(st, cluster->clusterX, cluster->clusterY);
+	while (st->clustertable[slot] != cluster) {
+		assert(st->clustertable[slot] != NULL);
+		slot = (slot + 1) & mask;
+	}
+
+	hole = slot;
+	for (;;) {
+		slot = (slot + 1) & mask;
+		if ((other = st->clustertable[slot]) == NULL)
+			break;
+
+		/* Move it unless its home slot lies between hole and slot. */
+		home = life_cluster_hash(st, other->clusterX, other->clusterY);
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			st->clustertable[hole] = other;
+			hole = slot;
+		}
+	}
+	st->clustertable[hole] = NULL;
+}
+
+
+struct cell_cluster *
+life_cluster_new(struct life_state *st, int clusterX, int clusterY)
+{
+	struct cell_cluster *cluster;
+	struct cell_cluster *neighbor;
+	int neighboridx;
+	int neighborX, neighborY;
+	int viewX, viewY;
+
+	life_cluster_wrap(st, &clusterX, &clusterY);
+	if ((cluster = life_cluster_lookup(st, clusterX, clusterY)) != NULL) {
+		/* Matches existing cluster; wake it if it is dormant. */
+		cluster->dormant = 0;
+		life_cluster_activate(st, cluster);
+		return (cluster);
+	}
+
+	cluster = life_pool_alloc(st);
+	cluster->clusterX = clusterX;
+	cluster->clusterY = clusterY;
+	life_table_insert(st, cluster);
+	st->numclusters++;
+	st->counters.created++;
+	if (life_cluster_visible(st, clusterX, clusterY, &viewX, &viewY)) {
+		st->numvisible++;
+		life_viewmap_set(st, viewX, viewY, True);
+	}
+	TAILQ_INSERT_TAIL(&st->active, cluster, link);
+	cluster->active = True;
+
+	/*
+	 * Cache pointers to neighboring clusters.  All universe-wrapping and
+	 * table lookups are done here so we don't have to do them in the
+	 * speed-critical simulation loop.
+	 */
+	for (neighboridx = 0; neighboridx < NUMDIRECTIONS; neighboridx++) {
+		neighborX = clusterX + direction_offset[neighboridx].x;
+		neighborY = clusterY + direction_offset[neighboridx].y;
+		life_cluster_wrap(st, &neighborX, &neighborY);
+
+		neighbor = life_cluster_lookup(st, neighborX, neighborY);
+		cluster->neighbor[neighboridx] = neighbor;
+
+		if (neighbor == NULL)
+			continue;
+
+		/*
+		 * Update our neighbor with a link back to this new
+		 * cluster.  This relies on direction (X) and direction
+		 * (NUMDIRECTIONS - X - 1) being opposites.
+		 * Note that with large cell sizes, clusters may be
+		 * their own neighbor.
+		 */
+		assert(neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] == NULL ||
+		       neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] == cluster);
+		neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] = cluster;
+	}
+
+	return (cluster);
+}
+
+
+void
+life_cluster_delete(struct life_state *st, struct cell_cluster *cluster)
+{
+	struct cell_cluster *neighbor;
+	int neighboridx;
+	int viewX, viewY;
+
+	assert(cluster->numcells == 0);
+	assert(st->numclusters > 0);
+
+	for (neighboridx = 0; neighboridx < NUMDIRECTIONS; neighboridx++) {
+		neighbor = cluster->neighbor[neighboridx];
+		if (neighbor == NULL)
+			continue;
+
+		/*
+		 * Clear our neighbors' link to this cluster.  This relies on
+		 * direction (X) and direction (NUMDIRECTIONS - X - 1) being
+		 * opposites.
+		 */
+		assert(neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] != NULL);
+		neighbor->neighbor[NUMDIRECTIONS - 1 - neighboridx] = NULL;
+	}
+
+	life_table_remove(st, cluster);
+	st->numclusters--;
+	st->counters.deleted++;
+	if (life_cluster_visible(st, cluster->clusterX, cluster->clusterY,
+				 &viewX, &viewY)) {
+		st->numvisible--;
+		life_viewmap_set(st, viewX, viewY, False);
+	}
+	if (cluster->active)
+		TAILQ_REMOVE(&st->active, cluster, link);
+	else
+		TAILQ_REMOVE(&st->idle, cluster, link);
+	life_pool_release(st, cluster);
+}
+
+
+/*
+ * life_cell_color() - Wrap a pattern color around the colors alive cells have.
+ */
+static __inline
+int
+life_cell_color(const struct life_state * const st, int color)
+{
+
+	while (color <= CELL_MINALIVE)
+		color += st->numcolors;
+	while (color >= st->colorwrap)
+		color -= st->colorwrap;
+	return (color);
+}
+
+
+/*
+ * life_cell_wakemask() - Neighbors to wake for a cell born at (x, y).
+ *
+ *	In the form of cluster->wake, for life_cluster_wake().
+ */
+static __inline
+unsigned char
+life_cell_wakemask(int x, int y)
+{
+	unsigned char wake = 0;
+
+	if (y == 0) {
+		if (x == 0)
+			wake |= 1 << NORTHWEST;
+		wake |= 1 << NORTH;
+		if (x == CLUSTERSIZE - 1)
+			wake |= 1 << NORTHEAST;
+	}
+	if (x == 0)
+		wake |= 1 << WEST;
+	if (x == CLUSTERSIZE - 1)
+		wake |= 1 << EAST;
+	if (y == CLUSTERSIZE - 1) {
+		if (x == 0)
+			wake |= 1 << SOUTHWEST;
+		wake |= 1 << SOUTH;
+		if (x == CLUSTERSIZE - 1)
+			wake |= 1 << SOUTHEAST;
+	}
+	return (wake);
+}
+
+
+/*
+ * life_cell_set() - Sets a cell to alive.
+ *
+ *	This interface, while general, is horribly inefficient.  It is only
+ *	used to draw patterns which are specified by coordinates.  Anything
+ *	in the fast-path should avoid this routine like the plague.
+ *
+ *	In this case, color should be a number between 0 and numcolors.  We'll
+ *	take care of adjusting it to avoid the CELL_DEAD "color".  x and y
+ *	are cell coordinates in the universe, which until the view is panned
+ *	are the same as those in the view.
+ */
+void
+life_cell_set(struct life_state *st, int x, int y, int color)
+{
+	struct cell_cluster *cluster;
+	cell (*cells)[CLUSTERSIZE];
+	int clusterX, clusterY;
+	int cellidx;
+
+	/*
+	 * First, handle wrapping of the color coordinate.
+	 * Note that this routine cannot be called to kill cells.
+	 */
+	color = life_cell_color(st, color);
+
+	if (st->hashlife != NULL) {
+		/* Wrap the X and Y coordinates around the display. */
+		while (x < 0)
+			x += st->cell_numX;
+		while (x >= st->cell_numX)
+			x -= st->cell_numX;
+		while (y < 0)
+			y += st->cell_numY;
+		while (y >= st->cell_numY)
+			y -= st->cell_numY;
+
+		cellidx = y * st->cell_numX + x;
+		if (st->hashcells[cellidx] != CELL_DEAD) {
+			st->hashcells[cellidx] = CELL_MINALIVE +
+			    ((st->hashcells[cellidx] - CELL_MINALIVE +
+			      color) / 2);
+			return;
+		}
+		st->hashcells[cellidx] = color + CELL_MINALIVE;
+		st->numcells++;
+		hashlife_set(st->hashlife, x - st->cell_numX / 2,
+			     y - st->cell_numY / 2);
+		return;
+	}
+
+	/*
+	 * Now convert into <cluster, cell> coordinates, rounding towards
+	 * negative infinity.  life_cluster_new() wraps the cluster
+	 * coordinates around the universe.
+	 */
+	clusterX = (x >= 0 ? x : x - (CLUSTERSIZE - 1)) / CLUSTERSIZE;
+	clusterY = (y >= 0 ? y : y - (CLUSTERSIZE - 1)) / CLUSTERSIZE;
+	x -= clusterX * CLUSTERSIZE;
+	y -= clusterY * CLUSTERSIZE;
+
+	cluster = life_cluster_new(st, clusterX, clusterY);
+	cells = LIFE_CURGEN(st, cluster);
+
+	if (cells[y][x] != CELL_DEAD) {
+		/* Already a cell there.  Let's merge them. */
+		cells[y][x] = CELL_MINALIVE +
+			((cells[y][x] - CELL_MINALIVE + color) / 2);
+		return;
+	}
+
+	cells[y][x] = color + CELL_MINALIVE;
+	cluster->numcells++;
+	st->numcells++;
+
+	cluster->dormant = 0;
+	cluster->wake |= life_cell_wakemask(x, y);
+	life_cluster_wake(st, cluster);
+}
+
+
+static __inline
+int
+randbit(void)
+{
+	static unsigned int randbits;
+	static int randcount = 0;
+	int rv;
+
+	if (randcount == 0) {
+		randbits = random();
+		randcount = 32;		/* Good for 32 bits. */
+	}
+
+	rv = randbits & 0x01;
+	randbits >>= 1;
+	return (rv);
+}
+
+
+/*
+ * life_stamp_row() - Take a cluster row's worth of bits from a stamp row.
+ *
+ *	x is the column of the first bit, which may be as far as a cluster
+ *	to the left of the row; columns there are empty.
+ */
+static __inline
+clusterrow
+life_stamp_row(const uint64_t *row, int x)
+{
+	uint64_t bits;
+
+	if (x < 0)
+		return ((clusterrow)(row[0] << -x));
+	bits = row[x / 64] >> (x % 64);
+	if (x % 64 != 0)
+		bits |= row[x / 64 + 1] << (64 - x % 64);
+	return ((clusterrow)bits);
+}
+
+
+/*
+ * life_stamp_draw() - Lay down an oriented pattern stamp at (cellX, cellY).
+ *
+ *	The pattern is laid down a row of clusters at a time.  Each cluster
+ *	under the pattern is looked up just once, the bits for each of its
+ *	rows are taken from the stamp with a couple of shifts, and its
+ *	neighbors are woken once the row of clusters is done.  Only the
+ *	cells themselves, which have colors, are still set one at a time,
+ *	in order along each row across the whole pattern.
+ */
+static
+void
+life_stamp_draw(struct life_state *st, const struct pattern_stamp *stamp,
+		int orientation, int cellX, int cellY, int color)
+{
+	const struct pattern_orientation *orient;
+	struct cell_cluster *cluster;
+	cell (*cells)[CLUSTERSIZE];
+	const uint64_t *row;
+	clusterrow bits;
+	int clusterX, clusterY;
+	int shiftX, shiftY;
+	int numX, numY;
+	int i, j;
+	int x, y;
+	int rowidx;
+	int newcolor;
+
+	orient = &stamp->orientations[orientation];
+	shiftX = cellX & (CLUSTERSIZE - 1);
+	shiftY = cellY & (CLUSTERSIZE - 1);
+	clusterX = (cellX - shiftX) / CLUSTERSIZE;
+	clusterY = (cellY - shiftY) / CLUSTERSIZE;
+	numX = (shiftX + orient->width) / CLUSTERSIZE + 1;
+	numY = (shiftY + orient->height) / CLUSTERSIZE + 1;
+
+	for (j = 0; j < numY; j++) {
+		memset(stamp->slots, 0, numX * sizeof(stamp->slots[0]));
+		for (y = 0; y < CLUSTERSIZE; y++) {
+			rowidx = j * CLUSTERSIZE + y - shiftY;
+			if (rowidx < 0)
+				continue;
+			if (rowidx > (int)orient->height)
+				break;
+			row = orient->bits + (size_t)rowidx * orient->rowwords;
+
+			for (i = 0; i < numX; i++) {
+				bits = life_stamp_row(row,
+						      i * CLUSTERSIZE - shiftX);
+				if (bits == 0)
+					continue;
+				if ((cluster = stamp->slots[i]) == NULL) {
+					cluster = life_cluster_new(st,
+					    clusterX + i, clusterY + j);
+					stamp->slots[i] = cluster;
+				}
+				cells = LIFE_CURGEN(st, cluster);
+
+				for (x = 0; bits != 0; x++, bits >>= 1) {
+					if ((bits & 1) == 0)
+						continue;
+					newcolor = life_cell_color(st, color);
+					color += randbit();
+
+					if (cells[y][x] != CELL_DEAD) {
+						/* Merge, as life_cell_set(). */
+						cells[y][x] = CELL_MINALIVE +
+						    ((cells[y][x] -
+						      CELL_MINALIVE +
+						      newcolor) / 2);
+						continue;
+					}
+					cells[y][x] = newcolor + CELL_MINALIVE;
+					cluster->numcells++;
+					st->numcells++;
+					cluster->wake |=
+					    life_cell_wakemask(x, y);
+				}
+			}
+		}
+
+		for (i = 0; i < numX; i++) {
+			if (stamp->slots[i] != NULL)
+				life_cluster_wake(st, stamp->slots[i]);
+		}
+	}
+}
+
+
+/*
+ * Hashlife engine glue.  The universe is unbounded, with the display
+ * centered on the origin; cells more than half a display away from the
+ * display are discarded every generation so that gliders which leave do
+ * not hang around forever.  Since hashlife only knows whether cells are
+ * alive, colors are reconstructed after every step: surviving cells keep
+ * their color and newborn cells get the average color of their neighbors
+ * in the previous frame (or a random one, when skipping many generations
+ * leaves them without any), much as in the cluster engine.
+ *	LIFE_HASHNODES	- Hashlife nodes to allow before collecting garbage.
+ *	LIFE_HASHFILL	- Add patterns while fewer than 1 in this many
+ *			  cells are alive.
+ */
+#define	LIFE_HASHNODES	(1 << 20)
+#define	LIFE_HASHFILL	256
+
+void
+life_hashlife_init(struct life_state *st, const struct life_params *params)
+{
+
+	st->hashstep = params->hashstep;
+	if (st->hashstep < 0)
+		st->hashstep = 0;
+	st->hashwarmup = params->hashwarmup;
+	if (st->hashwarmup < 0)
+		st->hashwarmup = 0;
+
+	life_hashlife_view(st);
+	st->hashlife = hashlife_new(LIFE_HASHNODES);
+}
+
+
+/*
+ * life_hashlife_view() - Size the crop square and cell buffers to the view.
+ */
+static
+void
+life_hashlife_view(struct life_state *st)
+{
+	int size;
+
+	/* Keep a square twice as large as the display. */
+	size = st->cell_numX > st->cell_numY ? st->cell_numX : st->cell_numY;
+	for (st->hashcrop = 0; (1 << st->hashcrop) < size * 2; st->hashcrop++)
+		continue;
+
+	st->hashcells = calloc(st->maxcells, sizeof(cell));
+	st->hashnext = calloc(st->maxcells, sizeof(cell));
+	st->hashdrawn = calloc(st->maxcells, sizeof(cell));
+	if (st->hashcells == NULL || st->hashnext == NULL ||
+	    st->hashdrawn == NULL)
+		exit(1);
+}
+
+
+/*
+ * life_hashlife_resize() - Follow a change in the size of the view.
+ *
+ *	The display stays centered on the origin, so the colors of the cells
+ *	still on screen are carried over around the center.  Nothing has
+ *	been drawn at the new size yet.
+ */
+static
+void
+life_hashlife_resize(struct life_state *st, int oldcell_numX,
+		     int oldcell_numY)
+{
+	cell *oldcells;
+	int oldX, oldY;
+	int x, y;
+
+	oldcells = st->hashcells;
+	free(st->hashnext);
+	free(st->hashdrawn);
+	life_hashlife_view(st);
+
+	for (oldY = 0; oldY < oldcell_numY; oldY++) {
+		y = oldY - oldcell_numY / 2 + st->cell_numY / 2;
+		if (y < 0 || y >= st->cell_numY)
+			continue;
+		for (oldX = 0; oldX < oldcell_numX; oldX++) {
+			x = oldX - oldcell_numX / 2 + st->cell_numX / 2;
+			if (x < 0 || x >= st->cell_numX)
+				continue;
+			st->hashcells[y * st->cell_numX + x] =
+			    oldcells[oldY * oldcell_numX + oldX];
+		}
+	}
+	free(oldcells);
+
+	hashlife_crop(st->hashlife, st->hashcrop);
+	life_hashlife_recolor(st);
+}
+
+
+void
+life_hashlife_free(struct life_state *st)
+{
+
+	hashlife_free(st->hashlife);
+	st->hashlife = NULL;
+	free(st->hashcells);
+	free(st->hashnext);
+	free(st->hashdrawn);
+}
+
+
+/*
+ * life_hashlife_color() - Color a live cell after a step.
+ *
+ *	Called through hashlife_getcells() for each live cell on screen.
+ *	The new colors go in hashnext; hashcells still holds the old ones.
+ */
+static
+void
+life_hashlife_color(void *arg, int64_t hashX, int64_t hashY)
+{
+	struct life_state *st = arg;
+	const cell *cells = st->hashcells;
+	int cellX, cellY;
+	int x, y;
+	int count, sum;
+	int cellidx;
+
+	cellX = hashX + st->cell_numX / 2;
+	cellY = hashY + st->cell_numY / 2;
+	cellidx = cellY * st->cell_numX + cellX;
+	st->numcells++;
+
+	if (cells[cellidx] != CELL_DEAD) {
+		/* Survivor. */
+		st->hashnext[cellidx] = cells[cellidx];
+		return;
+	}
+
+	count = sum = 0;
+	for (y = cellY - 1; y <= cellY + 1; y++) {
+		if (y < 0 || y >= st->cell_numY)
+			continue;
+		for (x = cellX - 1; x <= cellX + 1; x++) {
+			if (x < 0 || x >= st->cell_numX ||
+			    cells[y * st->cell_numX + x] == CELL_DEAD)
+				continue;
+			sum += cells[y * st->cell_numX + x] - CELL_MINALIVE;
+			count++;
+		}
+	}
+
+	/* life_cell_birthcolor() expects the sum of 3 neighbors. */
+	if (count != 0)
+		sum = sum * 3 / count;
+	else
+		sum = 3 * (random() % st->numcolors);
+	st->hashnext[cellidx] = life_cell_birthcolor(st, sum, NULL);
+}
+
+
+/*
+ * life_hashlife_recolor() - Color the cells on screen after a step.
+ */
+static
+void
+life_hashlife_recolor(struct life_state *st)
+{
+	cell *cells;
+
+	memset(st->hashnext, CELL_DEAD, st->maxcells * sizeof(cell));
+	st->numcells = 0;
+	hashlife_getcells(st->hashlife,
+			  -(st->cell_numX / 2), -(st->cell_numY / 2),
+			  st->cell_numX, st->cell_numY,
+			  life_hashlife_color, st);
+
+	cells = st->hashcells;
+	st->hashcells = st->hashnext;
+	st->hashnext = cells;
+}
+
+
+/*
+ * life_hashlife_update() - Advance the hashlife universe.
+ *
+ *	Each call advances 2^hashStep generations.  If the warmup resource
+ *	is set, the universe is populated and advanced 2^warmup generations
+ *	before the first frame.
+ */
+void
+life_hashlife_update(struct life_state *st)
+{
+	int log2gens = st->hashstep;
+
+	if (st->iteration == 0 && st->hashwarmup > 0) {
+		while (!st->nofill &&
+		       st->numcells * LIFE_HASHFILL < st->maxcells)
+			life_pattern_add(st);
+		log2gens = st->hashwarmup;
+	}
+
+	hashlife_step(st->hashlife, log2gens);
+	hashlife_crop(st->hashlife, st->hashcrop);
+	life_hashlife_recolor(st);
+	st->counters.generations += (uint64_t)1 << log2gens;
+
+	if (!st->nofill && (st->iteration % 256 == 0 ||
+	    st->numcells * LIFE_HASHFILL < st->maxcells))
+		life_pattern_add(st);
+}
+
+
+/*
+ * life_loader_cancelled() - Whether life_pattern_free() wants the loader gone.
+ */
+static
+int
+life_loader_cancelled(struct pattern_loader *loader)
+{
+	int cancel = False;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&loader->lock);
+	cancel = loader->cancel;
+	pthread_mutex_unlock(&loader->lock);
+#endif
+	return (cancel);
+}
+
+
+/*
+ * life_loader_scan() - Pick the sources of patterns to load.
+ *
+ *	Builds a list of NUMPATTERNS files, or patterns in packs, to read
+ *	from.  It is possible that not all of the files contain usable
+ *	patterns; we have some built-in patterns, though.
+ */
+static
+void
+life_loader_scan(struct pattern_loader *loader)
+{
+	struct pattern_source *sources = loader->sources;
+	struct pattern_pack *pack;
+	char *path;
+	char *pattern_dir;
+	char *packname;
+	unsigned int idx;
+	int count;
+	int pos;
+	size_t len;
+
+	count = 0;
+	path = loader->path;
+	while ((pattern_dir = strsep(&path, ":")) != NULL) {
+		struct dirent *entry;
+		DIR *dir;
+
+		/* Trim trailing slashes off of the directory name. */
+		len = strlen(pattern_dir);
+		while (len > 0 && pattern_dir[len - 1] == '/') {
+			pattern_dir[len - 1] = '\0';
+			len--;
+		}
+
+		pack = life_pack_open(pattern_dir);
+		if (pack == NULL) {
+			len = strlen(pattern_dir) + sizeof("/" PACK_FILENAME);
+			packname = malloc(len);
+			if (packname == NULL)
+				exit(1);
+			snprintf(packname, len, "%s/%s", pattern_dir,
+				 PACK_FILENAME);
+			pack = life_pack_open(packname);
+			free(packname);
+		}
+		if (pack != NULL) {
+			pack->next = loader->packs;
+			loader->packs = pack;
+			for (idx = 0; idx < pack->numpatterns; idx++) {
+				pos = rand_r(&loader->randstate) % (count + 2);
+				if (pos >= NUMPATTERNS)
+					continue;
+
+				free(sources[pos].filename);
+				sources[pos].filename = NULL;
+				sources[pos].pack = pack;
+				sources[pos].idx = idx;
+				count++;
+			}
+			continue;
+		}
+
+		dir = opendir(pattern_dir);
+		if (dir == NULL)
+			continue;
+
+		while ((entry = readdir(dir)) != NULL &&
+		       !life_loader_cancelled(loader)) {
+			if (entry->d_type != DT_REG)
+				continue;
+
+			/* XXX Magic Hack */
+			pos = rand_r(&loader->randstate) % (count + 2);
+			if (pos >= NUMPATTERNS)
+				continue;
+
+			if (sources[pos].filename != NULL)
+				free(sources[pos].filename);
+			sources[pos].pack = NULL;
+
+			len = strlen(pattern_dir) + 1 + entry->d_namlen + 1;
+			sources[pos].filename = malloc(len);
+			if (sources[pos].filename == NULL)
+				continue;
+
+			snprintf(sources[pos].filename, len, "%s/%s",
+				 pattern_dir, entry->d_name);
+			count++;
+		}
+
+		closedir(dir);
+	}
+}
+
+
+/*
+ * life_loader_work() - Parse sources until there are none left.
+ *
+ *	Each pattern parsed is also rasterized, so that the thread drawing
+ *	patterns does not have to.
+ */
+static
+void *
+life_loader_work(void *arg)
+{
+	struct pattern_loader *loader = arg;
+	const struct pattern_source *source;
+	struct pattern *pattern;
+	int pos;
+
+	for (;;) {
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&loader->lock);
+		pos = loader->cancel ? NUMPATTERNS : loader->nextsource++;
+		pthread_mutex_unlock(&loader->lock);
+#else
+		pos = loader->nextsource++;
+#endif
+		if (pos >= NUMPATTERNS)
+			break;
+
+		source = &loader->sources[pos];
+		pattern = &loader->patterns[pos];
+		if (source->pack != NULL)
+			loader->loaded[pos] = life_pack_pattern(&loader->limits,
+			    source->pack, source->idx, pattern);
+		else if (source->filename != NULL)
+			loader->loaded[pos] = life_pattern_read(&loader->limits,
+			    source->filename, pattern);
+		if (loader->loaded[pos])
+			life_pattern_stamp(pattern);
+	}
+	return (NULL);
+}
+
+
+/*
+ * life_loader_main() - Load the patterns in the pattern path.
+ *
+ *	Sources are parsed by up to numthreads threads at once, each taking
+ *	the next one not yet taken; which patterns are loaded does not depend
+ *	on which thread gets to which.
+ */
+static
+void *
+life_loader_main(void *arg)
+{
+	struct pattern_loader *loader = arg;
+#ifdef HAVE_PTHREAD
+	pthread_t helpers[NUMPATTERNS];
+	int numhelpers;
+	int i;
+#endif
+
+	life_loader_scan(loader);
+
+#ifdef HAVE_PTHREAD
+	for (numhelpers = 0; numhelpers < loader->numthreads - 1 &&
+	     numhelpers < NUMPATTERNS - 1; numhelpers++) {
+		if (pthread_create(&helpers[numhelpers], NULL,
+				   life_loader_work, loader) != 0)
+			break;
+	}
+	life_loader_work(loader);
+	for (i = 0; i < numhelpers; i++)
+		pthread_join(helpers[i], NULL);
+
+	pthread_mutex_lock(&loader->lock);
+	loader->done = True;
+	pthread_mutex_unlock(&loader->lock);
+#else
+	life_loader_work(loader);
+#endif
+	return (NULL);
+}
+
+
+/*
+ * life_loader_publish() - Put loaded patterns in place of the padding.
+ *
+ *	Patterns are taken in the order their sources were picked in, up to
+ *	NUMPATTERNS (including builtins); any left over are freed.  The
+ *	loader is freed too.
+ */
+static
+void
+life_loader_publish(struct life_state *st, struct pattern_loader *loader)
+{
+	struct pattern *pattern;
+	int count;
+	int pos;
+
+	count = NUMPATTERNSBUILTIN;
+	for (pos = 0; pos < NUMPATTERNS; pos++) {
+		if (!loader->loaded[pos])
+			continue;
+
+		pattern = &loader->patterns[pos];
+		if (count < NUMPATTERNS) {
+			st->patterns[count++] = *pattern;
+#ifdef LIFE_PRINTPATTERNS
+			if (loader->sources[pos].pack != NULL)
+				fprintf(stderr, "Loaded pattern %u from pack\n",
+					loader->sources[pos].idx);
+			else
+				fprintf(stderr, "Loaded pattern %s\n",
+					loader->sources[pos].filename);
+#endif
+			continue;
+		}
+		life_stamp_free(pattern->stamp);
+		if (loader->sources[pos].pack == NULL)
+			free(pattern->coords);
+	}
+
+	/* Pad out empty entries in the pattern array. */
+	for (pos = 0; count < NUMPATTERNS; pos++, count++)
+		st->patterns[count] = st->patterns[pos];
+	st->packs = loader->packs;
+
+	/* Free memory allocated to filenames. */
+	for (pos = 0; pos < NUMPATTERNS; pos++) {
+		if (loader->sources[pos].filename != NULL)
+			free(loader->sources[pos].filename);
+	}
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&loader->lock);
+#endif
+	free(loader->path);
+	free(loader);
+}
+
+
+#ifdef HAVE_PTHREAD
+/*
+ * life_pattern_poll() - Publish patterns loaded in the background, if done.
+ */
+static
+void
+life_pattern_poll(struct life_state *st)
+{
+	struct pattern_loader *loader = st->loader;
+	int done;
+
+	pthread_mutex_lock(&loader->lock);
+	done = loader->done;
+	pthread_mutex_unlock(&loader->lock);
+	if (!done)
+		return;
+
+	pthread_join(loader->thread, NULL);
+	st->loader = NULL;
+	life_loader_publish(st, loader);
+}
+#endif
+
+
+/*
+ * life_pattern_init() - Load patterns from the directories in pattern_path.
+ *
+ *	pattern_path is a colon-separated list of directories, or NULL.  Each
+ *	may instead be a pattern pack, or contain one named PACK_FILENAME, in
+ *	which case patterns are taken from the pack and the directory is not
+ *	read at all.
+ *
+ *	If background is set, the patterns are loaded by another thread, if
+ *	possible, and only the builtin patterns are drawn until they are
+ *	ready; otherwise they are loaded before returning.  Which patterns
+ *	are loaded only depends on the state of random() at the time of the
+ *	call, either way.
+ */
+void
+life_pattern_init(struct life_state *st, const char *pattern_path,
+		  int background)
+{
+	struct pattern_loader *loader;
+	int count;
+	int pos;
+
+	/*
+	 * Initialize pattern list with built-in patterns.
+	 */
+	memcpy(st->patterns, builtin_patterns, sizeof(builtin_patterns));
+	for (pos = 0; pos < NUMPATTERNSBUILTIN; pos++)
+		life_pattern_stamp(&st->patterns[pos]);
+	for (pos = 0, count = NUMPATTERNSBUILTIN; count < NUMPATTERNS;
+	     pos++, count++)
+		st->patterns[count] = st->patterns[pos];
+	st->packs = NULL;
+
+	loader = calloc(1, sizeof(*loader));
+	if (loader == NULL)
+		exit(1);
+	loader->limits.cell_numX = st->cell_numX;
+	loader->limits.cell_numY = st->cell_numY;
+	if (pattern_path != NULL && (loader->path = strdup(pattern_path)) ==
+	    NULL)
+		exit(1);
+	loader->randstate = random();
+	loader->numthreads = st->numthreads;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&loader->lock, NULL);
+	st->loader = NULL;
+	if (background && pattern_path != NULL &&
+	    pthread_create(&loader->thread, NULL, life_loader_main,
+			   loader) == 0) {
+		st->loader = loader;
+		return;
+	}
+#endif
+	life_loader_main(loader);
+	life_loader_publish(st, loader);
+}
+
+
+void
+life_pattern_free(struct life_state *st)
+{
+	struct pattern_pack *pack;
+	struct coords *coords0;
+	const char *coords;
+	int i;
+
+#ifdef HAVE_PTHREAD
+	/* Stop loading patterns, and free whatever was loaded. */
+	if (st->loader != NULL) {
+		pthread_mutex_lock(&st->loader->lock);
+		st->loader->cancel = True;
+		pthread_mutex_unlock(&st->loader->lock);
+		pthread_join(st->loader->thread, NULL);
+		life_loader_publish(st, st->loader);
+		st->loader = NULL;
+	}
+#endif
+
+	/*
+	 * The pattern array is always padded out to NUMPATTERNS entries
+	 * by duplicating patterns as necessary.  In addition, the first
+	 * NUMPATTERNSBUILTIN patterns are static and do not need freeing.
+	 * As such, we free the patterns starting at index NUMPATTERNSBUILTIN
+	 * and continueing through the array until we see pattern #0
+	 * duplicated or we free NUMPATTERNS, whichever comes first.
+	 * Patterns in packs are left for the packs to be unmapped.  Every
+	 * pattern up to there, builtin or not, has a stamp to free.
+	 */
+	coords0 = st->patterns[0].coords;
+
+	for (i = 0; i < NUMPATTERNS; i++) {
+		if (i > 0 && st->patterns[i].coords == coords0)
+			break;
+		life_stamp_free(st->patterns[i].stamp);
+		if (i < NUMPATTERNSBUILTIN)
+			continue;
+		coords = (const char *)st->patterns[i].coords;
+		for (pack = st->packs; pack != NULL; pack = pack->next) {
+			if (coords >= (const char *)pack->base &&
+			    coords < (const char *)pack->base + pack->size)
+				break;
+		}
+		if (pack == NULL)
+			free(st->patterns[i].coords);
+	}
+
+	while ((pack = st->packs) != NULL) {
+		st->packs = pack->next;
+		life_pack_close(pack);
+	}
+}
+
+
+/*
+ * life_pattern_add() - Add a random pattern to the view, if there is room.
+ *
+ *	Counts the patterns added and the time spent trying.
+ */
+static
+void
+life_pattern_add(struct life_state *st)
+{
+	int64_t start;
+
+	start = life_time();
+#ifdef HAVE_PTHREAD
+	if (st->loader != NULL)
+		life_pattern_poll(st);
+#endif
+	if (life_pattern_draw(st))
+		st->counters.patterns++;
+	st->counters.patterntime += life_time() - start;
+}
+
+
+/*
+ * life_pattern_draw() - Draw a random pattern somewhere empty in the view.
+ *
+ *	Returns boolean false if no empty place was found.
+ */
+int
+life_pattern_draw(struct life_state *st)
+{
+	struct pattern *pattern;
+	const struct coords *coord, *endcoord;
+	struct coords oriented;
+	int cellX, cellY;
+	int color;
+	int orientation;
+	int clusterX, clusterY;
+	int viewX, viewY;
+	int offsetX, offsetY;
+	int failX, failY;
+	int tries;
+
+	/*
+	 * Pick a random pattern, orientation and position within a cluster.
+	 * Tries up to 5 times to find a pattern for which there is room: a
+	 * block of clusters in the view, none of which exist yet, as large
+	 * as the pattern covers.  The hashlife engine has no clusters, so
+	 * anywhere will do.
+	 */
+	failX = failY = INT_MAX;
+	for (tries = 5; tries > 0; tries--) {
+		int needX, needY;
+
+		pattern = &st->patterns[random() % NUMPATTERNS];
+		orientation = random() % NUMORIENTATIONS;
+		offsetX = random() % CLUSTERSIZE;
+		offsetY = random() % CLUSTERSIZE;
+
+		if (st->hashlife != NULL) {
+			viewX = random() % st->cluster_numX;
+			viewY = random() % st->cluster_numY;
+			break;
+		}
+
+		if (orientation & ORIENT_TRANSPOSE) {
+			needX = (offsetX + pattern->height) / CLUSTERSIZE + 1;
+			needY = (offsetY + pattern->width) / CLUSTERSIZE + 1;
+		} else {
+			needX = (offsetX + pattern->width) / CLUSTERSIZE + 1;
+			needY = (offsetY + pattern->height) / CLUSTERSIZE + 1;
+		}
+
+		/*
+		 * If this pattern needs at least as much room as one which
+		 * did not fit then we don't have a chance of succeeding.
+		 */
+		if (needX >= failX && needY >= failY)
+			continue;
+
+		if (life_viewmap_find(st, needX, needY, &viewX, &viewY))
+			break;
+		failX = needX;
+		failY = needY;
+	}
+
+	/* No room.  Hope for better luck next time... */
+	if (tries == 0)
+		return (False);
+
+	clusterX = st->view_clusterX + viewX;
+	clusterY = st->view_clusterY + viewY;
+	life_cluster_wrap(st, &clusterX, &clusterY);
+	cellX = clusterX * CLUSTERSIZE + offsetX;
+	cellY = clusterY * CLUSTERSIZE + offsetY;
+
+	coord = pattern->coords;
+	endcoord = pattern->coords + pattern->numcoords;
+
+	/*
+	 * Write pattern, in any of its orientations.  Hashlife takes cells
+	 * one at a time anyway, so the stamp is of no use to it.
+	 */
+
+	color = random() % st->numcolors;
+
+	if (st->hashlife == NULL && pattern->stamp != NULL) {
+		life_stamp_draw(st, pattern->stamp, orientation, cellX, cellY,
+				color);
+		return (True);
+	}
+	for (; coord < endcoord; coord++) {
+		life_pattern_orient(pattern, orientation, coord, &oriented);
+		life_cell_set(st, cellX + oriented.x, cellY + oriented.y,
+			      color);
+		color += randbit();
+	}
+	return (True);
+}
+
+
+/*
+ * Snapshots of the universe; see the note in clife_sim.h.
+ *	LIFE_SNAPSHOTLIMIT - Furthest a record may lie from the view, in
+ *			     clusters, so that cell coordinates fit an int.
+ */
+#define	LIFE_SNAPSHOTLIMIT	(INT_MAX / CLUSTERSIZE / 4)
+
+/*
+ * life_snapshot_write() - Add a cluster's worth of cells to a snapshot.
+ *
+ *	The cells are those of a cluster, or a block of the hashlife engine's
+ *	view, with rows stride cells apart.  Nothing is written if none of
+ *	them are alive.  Returns the number of records written.
+ */
+static
+int
+life_snapshot_write(FILE *f, const cell *cells, int stride,
+		    int viewX, int viewY)
+{
+	struct life_snapshotcluster record;
+	cell colors[CLUSTERSIZE * CLUSTERSIZE + 7];
+	size_t len;
+	int x, y;
+
+	memset(&record, 0, sizeof(record));
+	len = 0;
+	for (y = 0; y < CLUSTERSIZE; y++, cells += stride) {
+		for (x = 0; x < CLUSTERSIZE; x++) {
+			if (cells[x] == CELL_DEAD)
+				continue;
+			record.rows[y] |= (clusterrow)1 << x;
+			colors[len++] = cells[x];
+		}
+	}
+	if (len == 0)
+		return (0);
+
+	record.viewX = viewX;
+	record.viewY = viewY;
+	record.numcells = len;
+	while (len % 8 != 0)
+		colors[len++] = CELL_DEAD;
+	fwrite(&record, sizeof(record), 1, f);
+	fwrite(colors, len, 1, f);
+	return (1);
+}
+
+
+/*
+ * life_state_save() - Save the live cells of the universe to a snapshot.
+ *
+ *	The snapshot is written alongside and renamed over filename once it
+ *	is complete, so an earlier snapshot is never left half overwritten.
+ *	The hashlife engine only keeps the colors of the cells in the view,
+ *	so only those are saved.  Returns boolean false if it can't be saved.
+ */
+int
+life_state_save(const struct life_state * const st, const char *filename)
+{
+	const struct cell_cluster_list *lists[2] = { &st->active, &st->idle };
+	struct life_snapshotheader header;
+	const struct cell_cluster *cluster;
+	char *tempname;
+	int viewX, viewY;
+	int saved;
+	int i;
+	FILE *f;
+
+	tempname = malloc(strlen(filename) + sizeof(".new"));
+	if (tempname == NULL)
+		exit(1);
+	sprintf(tempname, "%s.new", filename);
+	f = fopen(tempname, "wb");
+	if (f == NULL) {
+		free(tempname);
+		return (False);
+	}
+
+	/* The header is written again once the clusters are counted. */
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.byteorder = PACK_BYTEORDER;
+	header.clustersize = CLUSTERSIZE;
+	fwrite(&header, sizeof(header), 1, f);
+
+	if (st->hashlife != NULL) {
+		for (viewY = 0; viewY < st->cluster_numY; viewY++) {
+			for (viewX = 0; viewX < st->cluster_numX; viewX++) {
+				header.numclusters += life_snapshot_write(f,
+				    st->hashcells + (size_t)viewY *
+				    CLUSTERSIZE * st->cell_numX +
+				    viewX * CLUSTERSIZE, st->cell_numX,
+				    viewX, viewY);
+			}
+		}
+	} else {
+		for (i = 0; i < 2; i++) {
+			TAILQ_FOREACH(cluster, lists[i], link) {
+				life_cluster_visible(st, cluster->clusterX,
+						     cluster->clusterY,
+						     &viewX, &viewY);
+				header.numclusters += life_snapshot_write(f,
+				    &LIFE_CURGEN(st, cluster)[0][0],
+				    CLUSTERSIZE, viewX, viewY);
+			}
+		}
+	}
+
+	rewind(f);
+	fwrite(&header, sizeof(header), 1, f);
+	saved = !ferror(f);
+	if (fclose(f) != 0)
+		saved = False;
+	if (saved && rename(tempname, filename) != 0)
+		saved = False;
+	if (!saved)
+		unlink(tempname);
+	free(tempname);
+	return (saved);
+}
+
+
+/*
+ * life_snapshot_check() - Check the records of a mapped snapshot.
+ *
+ *	Every record must lie within the file, have as many cell values as it
+ *	has live cells, and all of those must be alive.  Returns boolean false
+ *	if any of them is damaged.
+ */
+static
+int
+life_snapshot_check(const char *p, const char *end, uint32_t numclusters)
+{
+	const struct life_snapshotcluster *record;
+	const cell *colors;
+	clusterrow bits;
+	uint32_t numcells;
+	size_t len;
+	int y;
+
+	for (; numclusters > 0; numclusters--) {
+		if ((size_t)(end - p) < sizeof(*record))
+			return (False);
+		record = (const struct life_snapshotcluster *)p;
+		p += sizeof(*record);
+
+		numcells = 0;
+		for (y = 0; y < CLUSTERSIZE; y++) {
+			for (bits = record->rows[y]; bits != 0;
+			     bits &= bits - 1)
+				numcells++;
+		}
+		if (numcells == 0 || numcells != record->numcells ||
+		    record->viewX < -LIFE_SNAPSHOTLIMIT ||
+		    record->viewX > LIFE_SNAPSHOTLIMIT ||
+		    record->viewY < -LIFE_SNAPSHOTLIMIT ||
+		    record->viewY > LIFE_SNAPSHOTLIMIT)
+			return (False);
+
+		len = (numcells + 7) & ~(size_t)7;
+		if ((size_t)(end - p) < len)
+			return (False);
+		colors = (const cell *)p;
+		p += len;
+		while (numcells > 0) {
+			if (colors[--numcells] == CELL_DEAD)
+				return (False);
+		}
+	}
+	return (True);
+}
+
+
+/*
+ * life_snapshot_cell() - Bring a cell from a snapshot to life.
+ *
+ *	Values from a snapshot saved with more colors are wrapped around.
+ *	Returns boolean false if the cell was already alive, in which case
+ *	the two are merged as in life_cell_set().
+ */
+static __inline
+int
+life_snapshot_cell(const struct life_state * const st, cell *c, int value)
+{
+
+	if (value > st->colorwrap)
+		value = CELL_MINALIVE + (value - CELL_MINALIVE) % st->colorwrap;
+	if (*c != CELL_DEAD) {
+		*c = CELL_MINALIVE + ((*c - CELL_MINALIVE) +
+				      (value - CELL_MINALIVE)) / 2;
+		return (False);
+	}
+	*c = value;
+	return (True);
+}
+
+
+/*
+ * life_snapshot_read() - Bring a snapshot record's cells to life.
+ *
+ *	The cells go straight into the cluster at the record's place; they
+ *	start out awake, as do the neighbors they touch.  In a bounded
+ *	universe, records which lie outside it are dropped; the hashlife
+ *	engine drops any cells outside the view.
+ */
+static
+void
+life_snapshot_read(struct life_state *st,
+		   const struct life_snapshotcluster *record,
+		   const cell *colors)
+{
+	struct cell_cluster *cluster;
+	cell (*cells)[CLUSTERSIZE];
+	clusterrow bits;
+	int cellX, cellY;
+	int x, y;
+
+	if (st->hashlife != NULL) {
+		for (y = 0; y < CLUSTERSIZE; y++) {
+			cellY = record->viewY * CLUSTERSIZE + y;
+			for (bits = record->rows[y], x = 0; bits != 0;
+			     x++, bits >>= 1) {
+				if ((bits & 1) == 0)
+					continue;
+				cellX = record->viewX * CLUSTERSIZE + x;
+				if (cellX < 0 || cellX >= st->cell_numX ||
+				    cellY < 0 || cellY >= st->cell_numY) {
+					colors++;
+					continue;
+				}
+				if (!life_snapshot_cell(st, &st->hashcells[
+				    cellY * st->cell_numX + cellX], *colors++))
+					continue;
+				st->numcells++;
+				hashlife_set(st->hashlife,
+					     cellX - st->cell_numX / 2,
+					     cellY - st->cell_numY / 2);
+			}
+		}
+		return;
+	}
+
+	if (st->universe_numX != 0 &&
+	    (record->viewX < 0 || record->viewX >= st->universe_numX ||
+	     record->viewY < 0 || record->viewY >= st->universe_numY))
+		return;
+
+	cluster = life_cluster_new(st, st->view_clusterX + record->viewX,
+				   st->view_clusterY + record->viewY);
+	cells = LIFE_CURGEN(st, cluster);
+	for (y = 0; y < CLUSTERSIZE; y++) {
+		for (bits = record->rows[y], x = 0; bits != 0;
+		     x++, bits >>= 1) {
+			if ((bits & 1) == 0)
+				continue;
+			if (!life_snapshot_cell(st, &cells[y][x], *colors++))
+				continue;
+			cluster->numcells++;
+			st->numcells++;
+		}
+	}
+	life_cluster_wakeedges(st, cluster);
+}
+
+
+/*
+ * life_state_restore() - Add the live cells saved in a snapshot.
+ *
+ *	The cells are placed relative to the view just as they were when they
+ *	were saved, merging with any cells already alive.  The snapshot is
+ *	mapped and checked in full first, so nothing is added from one which
+ *	is damaged.  Returns boolean false if the file can't be read or is not
+ *	a snapshot saved on a machine like this one with the same CLUSTERSIZE.
+ */
+int
+life_state_restore(struct life_state *st, const char *filename)
+{
+	const struct life_snapshotheader *header;
+	const struct life_snapshotcluster *record;
+	const char *base, *p, *end;
+	struct stat sb;
+	uint32_t i;
+	void *map;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return (False);
+	if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) ||
+	    (size_t)sb.st_size < sizeof(*header)) {
+		close(fd);
+		return (False);
+	}
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return (False);
+
+	base = map;
+	end = base + sb.st_size;
+	header = map;
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->byteorder != PACK_BYTEORDER ||
+	    header->clustersize != CLUSTERSIZE ||
+	    !life_snapshot_check(base + sizeof(*header), end,
+				 header->numclusters)) {
+		munmap(map, sb.st_size);
+		return (False);
+	}
+
+	p = base + sizeof(*header);
+	for (i = 0; i < header->numclusters; i++) {
+		record = (const struct life_snapshotcluster *)p;
+		p += sizeof(*record);
+		life_snapshot_read(st, record, (const cell *)p);
+		p += (record->numcells + 7) & ~(size_t)7;
+	}
+	munmap(map, sb.st_size);
+	return (True);
+}
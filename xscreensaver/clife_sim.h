@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2003,2007 Kelly Yancey (kbyanc@posi.net)
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+#ifndef CLIFE_SIM_H
+#define CLIFE_SIM_H
+
+#include <sys/queue.h>
+#include <stdint.h>
+
+/*
+ * Simulation core for clife.  Nothing here depends on Xlib: clife.c shows
+ * the universe in a window, while clife_headless.c runs it without an X
+ * server for profiling.  The universe is seen through a view of
+ * cluster_numX by cluster_numY clusters, which is where new patterns are
+ * added; the display (if any) shows exactly the view.
+ */
+
+#ifndef True
+# define True	1
+# define False	0
+#endif
+
+
+struct coords {
+	int x, y;
+};
+
+struct pattern {
+	unsigned int width, height;
+	unsigned int numcoords;
+	struct coords *coords;
+	struct pattern_stamp *stamp;	/* Once loaded; see below. */
+};
+
+/*
+ * Loaded patterns are also rasterized, once, in each of their 8
+ * orientations so that they can be laid down a cluster row at a time
+ * instead of a cell at a time; see life_pattern_stamp().  An orientation
+ * is a bitmap of height + 1 rows of rowwords words, with column x of a row
+ * at bit (x % 64) of word (x / 64).  The last word of each row is always
+ * empty, so that a cluster's worth of bits can be taken from any column.
+ * The orientation number is a mask of:
+ *	ORIENT_TRANSPOSE	- Swap X and Y, then
+ *	ORIENT_FLIPX		- mirror left to right, and
+ *	ORIENT_FLIPY		- mirror top to bottom.
+ */
+#define	ORIENT_FLIPX		0x01
+#define	ORIENT_FLIPY		0x02
+#define	ORIENT_TRANSPOSE	0x04
+#define	NUMORIENTATIONS		8
+
+struct pattern_orientation {
+	unsigned int	 width, height;	/* Less 1, as in struct pattern. */
+	unsigned int	 rowwords;
+	uint64_t	*bits;
+};
+
+struct pattern_stamp {
+	struct pattern_orientation orientations[NUMORIENTATIONS];
+	uint64_t	*bits;		/* Of all of the orientations. */
+	struct cell_cluster **slots;	/* Clusters across, when drawing. */
+};
+
+#define	NUMPATTERNS		16
+#define	NUMPATTERNSBUILTIN	3	/* Please don't add more. */
+
+/*
+ * A pattern pack holds many patterns, already parsed, in one file which is
+ * mapped into memory instead of read; see clife_pattern.c.  It starts with
+ * a header and an index entry per pattern, followed by the coordinates of
+ * each pattern as an array of struct coords.  Everything is in the byte
+ * order of the machine which made the pack.  clife-pack makes them.
+ *	PACK_MAGIC	- First 4 bytes of a pack.
+ *	PACK_BYTEORDER	- Tells whether the byte order matches.
+ *	PACK_FILENAME	- Name of the pack used in place of the other files
+ *			  in a directory of patterns.
+ */
+#define	PACK_MAGIC	"CLPK"
+#define	PACK_BYTEORDER	0x01020304
+#define	PACK_FILENAME	"clife.pack"
+
+struct pattern_packheader {
+	char		 magic[4];
+	uint32_t	 byteorder;
+	uint32_t	 coordsize;	/* sizeof(struct coords). */
+	uint32_t	 numpatterns;
+};
+
+struct pattern_packentry {
+	uint32_t	 width, height;	/* Less 1, as in struct pattern. */
+	uint32_t	 numcoords;
+	uint32_t	 offset;	/* Of the coordinates in the file. */
+};
+
+struct pattern_pack {
+	struct pattern_pack *next;
+	void		*base;		/* Mapping of the whole file. */
+	size_t		 size;
+	const struct pattern_packentry *entries;
+	unsigned int	 numpatterns;
+};
+
+
+/*
+ * A snapshot holds the live cells of the universe, so that it can be saved
+ * when clife exits and picked up again where it left off.  After a header
+ * comes a record for each cluster with live cells, giving its position
+ * relative to the top left cluster in the view and a bitmap of which of its
+ * cells are alive, followed by the value of each of those cells in order, a
+ * byte each, padded to 8 bytes.  Like a pack, a snapshot is mapped instead
+ * of read, and is in the byte order of the machine which saved it.  Cell
+ * ages are not kept.
+ *	SNAPSHOT_MAGIC	- First 4 bytes of a snapshot.
+ */
+#define	SNAPSHOT_MAGIC	"CLSS"
+
+struct life_snapshotheader {
+	char		 magic[4];
+	uint32_t	 byteorder;	/* PACK_BYTEORDER. */
+	uint32_t	 clustersize;	/* CLUSTERSIZE. */
+	uint32_t	 numclusters;
+};
+
+
+/*
+ * The following limits apply to dormant clusters.
+ *	LIMIT_DRAW	- Clusters dormant for more than this many iterations
+ *			  will not be drawn.  Must be at least 1.
+ *	LIMIT_UPDATE	- Clusters dormant for more than this many iterations
+ *			  will not be updated; useful for skipping static
+ *			  debris.  Must be at least 1 more than LIMIT_DRAW.
+ *	LIMIT_KEEPEMPTY	- Clusters with no cells are kept for this many
+ *			  cycles before deleting.  Should be greater than
+ *			  LIMIT_UPDATE.
+ *	LIMIT_SWEEP	- Clusters which are not being updated are only aged
+ *			  (and deleted) every this many iterations.
+ */
+#define	LIMIT_DRAW	1
+#define	LIMIT_UPDATE	LIMIT_DRAW + 1
+#define	LIMIT_KEEPEMPTY	16
+#define	LIMIT_SWEEP	8
+
+/*
+ * Upper limit on the number of generations computed between frames which
+ * are drawn, including skipped frames; dormant counters must not overflow.
+ */
+#define	LIFE_MAXGENSPERFRAME	100
+
+
+
+typedef	unsigned char cell;
+#define	CELL_DEAD	0
+#define	CELL_MINALIVE	1
+#define	CELL_MAXCOLORS	85	/* Must be less than or equal to 1/3 of the
+				 * maximum value representable by cell's type.
+				 * See note in life_display_init() in clife.c.
+				 */
+
+/*
+ * The directions must be ordered such that direction (X) and direction
+ * (NUMDIRECTIONS - X - 1) are opposites.  The following ordering is optimal
+ * because it follows this rule and is ordered by increasing Y offset followed
+ * by increasing X offset.
+ */
+#define NUMDIRECTIONS	8
+enum direction {
+	NORTHWEST = 0,
+	NORTH,
+	NORTHEAST,
+	WEST,
+	EAST,
+	SOUTHWEST,
+	SOUTH,
+	SOUTHEAST
+};
+
+
+/*
+ * Since the cell universe is often sparse, it is divided up into clusters
+ * CLUSTERSIZE cells per side.  This allows regions known to be empty to
+ * be skipped in the simulation loop.
+ *
+ * To prevent the frequent creation/deletion of nearly-empty clusters (i.e.
+ * when a blinker crosses a cluster boundary), clusters are not immediately
+ * freed when they become empty, but instead only after MAXDORMANTAGE
+ * iterations empty.  Similarly, when a neighboring cluster has cells on the
+ * adjacent edge, it will clear the dormant counter as an indication that the
+ * cluster should not be deleted as it needs to check for spillover.
+ *
+ * CLUSTERSIZE may be set at build time to 8, 16, 32 or 64.  Larger clusters
+ * cut the per-cluster overhead for dense universes; smaller ones waste less
+ * work on sparse ones.  A clusterrow has one bit per cell in a cluster's row
+ * (or column).
+ *
+ * The dormant counter is also used to avoid processing clusters which contain
+ * static debris, as is common in life.  Clusters which are dormant for less
+ * than LIMIT_UPDATE iterations are kept on the active list, which is all the
+ * simulation and drawing loops look at; the rest are on the idle list, which
+ * is only swept occasionally to age and delete empty clusters.  When several
+ * generations are computed per frame, both limits are stretched by the
+ * number of generations so that every cluster which changed since the last
+ * frame is still drawn.
+ *
+ * Each cluster holds two generations of cells.  cells[st->parity] is the
+ * current generation and the kernels compute the next one into the other
+ * buffer; once every cluster is done, flipping st->parity commits the new
+ * generation without copying anything.  A kernel only writes the cells that
+ * change, so the next buffer is first brought up to date from the current
+ * one, except when the cluster was dormant last generation as then both
+ * buffers already hold the same cells.  Clusters which are not updated at
+ * all are dormant, so both of their buffers always agree.
+ *
+ * The cell arrays are what the simulation loop spends its time on, so they
+ * come first, aligned to a cache line, followed by the neighbor pointers and
+ * the bookkeeping fields; the list linkage and coordinates, which are only
+ * used when clusters are created, deleted or drawn, are last.  Cell ages are
+ * only needed when the maxAge resource is set and are otherwise not
+ * allocated at all; see life_pool_alloc().  Likewise, the cells as last
+ * drawn are only kept when several generations are computed per frame;
+ * otherwise the previous generation is what was last drawn.
+ */
+#ifndef CLUSTERSIZE
+# define CLUSTERSIZE	8	/* Number of cells per cluster; power-of-2. */
+#endif
+#define	LIFE_CACHELINE	64
+#ifdef __GNUC__
+# define LIFE_CACHEALIGN __attribute__((aligned(LIFE_CACHELINE)))
+#else
+# define LIFE_CACHEALIGN
+#endif
+struct cell_cluster {
+	cell		 cells[2][CLUSTERSIZE][CLUSTERSIZE] LIFE_CACHEALIGN;
+	struct cell_cluster	*neighbor[NUMDIRECTIONS];
+	short			 numcells;
+	unsigned char		 dormant;	/* Iterations unchanged. */
+	unsigned char		 wake;		/* Neighbors to wake. */
+	unsigned char		 active;	/* On active list. */
+	short			 births;	/* In the last update. */
+
+	TAILQ_ENTRY(cell_cluster) link;		/* Active or idle list. */
+	int			 clusterX, clusterY;
+	unsigned char		(*cellage)[CLUSTERSIZE];	/* Or NULL. */
+	cell			(*drawn)[CLUSTERSIZE];		/* Or NULL. */
+};
+
+#if CLUSTERSIZE == 8
+typedef	uint8_t		clusterrow;
+#elif CLUSTERSIZE == 16
+typedef	uint16_t	clusterrow;
+#elif CLUSTERSIZE == 32
+typedef	uint32_t	clusterrow;
+#elif CLUSTERSIZE == 64
+typedef	uint64_t	clusterrow;
+#else
+# error "CLUSTERSIZE must be 8, 16, 32 or 64"
+#endif
+#define	CLUSTERROW_ALL	((clusterrow)~(clusterrow)0)
+
+struct life_snapshotcluster {
+	clusterrow	 rows[CLUSTERSIZE];	/* Bit x is cell x. */
+	int32_t		 viewX, viewY;
+	uint32_t	 numcells;	/* Bits set in rows. */
+};
+
+/*
+ * The current and next generation of a cluster's cells.  Between
+ * generations, the next generation buffer holds the previous generation.
+ */
+#define	LIFE_CURGEN(st, cluster)	((cluster)->cells[(st)->parity])
+#define	LIFE_NEXTGEN(st, cluster)	((cluster)->cells[!(st)->parity])
+
+
+
+/*
+ * Clusters are carved out of large page-aligned chunks rather than being
+ * allocated individually, since gliders and blinkers crossing cluster
+ * boundaries cause clusters to be created and deleted constantly.  Deleted
+ * clusters go on a free list and are only zeroed when they are reused;
+ * clusters which have never been handed out are not touched at all.  All
+ * chunks are released at once when the universe is torn down.
+ *	LIFE_POOLCHUNK	- Minimum size of a chunk, in bytes.
+ */
+#define	LIFE_POOLCHUNK	(64 * 1024)
+
+struct cluster_chunk {
+	struct cluster_chunk *next;
+	int		 numclusters;	/* Capacity of this chunk. */
+	int		 numcarved;	/* Clusters handed out so far. */
+	unsigned char	(*cellage)[CLUSTERSIZE][CLUSTERSIZE];	/* Or NULL. */
+	cell		(*drawn)[CLUSTERSIZE][CLUSTERSIZE];	/* Or NULL. */
+	struct cell_cluster clusters[];
+};
+
+struct cluster_pool {
+	struct cluster_chunk *chunks;	/* Most recent chunk first. */
+	struct cell_cluster *freelist;	/* Linked through neighbor[0]. */
+	size_t		 chunksize;
+	int		 numchunks;
+	int		 numlive;	/* Clusters in use. */
+	int		 numfree;	/* Clusters on the free list. */
+};
+
+
+
+
+/*
+ * Parameters for life_state_init().  Out of range values are clamped.
+ */
+struct life_params {
+	const char *progname;	/* For error messages. */
+	int	 cell_numX;	/* Size of the view in cells; rounded down */
+	int	 cell_numY;	/* to whole clusters, at least 1 each way. */
+	int	 scale;		/* Universe size in views, or 0 if unbounded. */
+	int	 numcolors;	/* Distinct live cell colors. */
+	int	 maxage;	/* Cells die at this age; 0 for never. */
+	int	 gensperdraw;	/* Most generations between frames drawn. */
+	int	 numthreads;	/* 0 for one per processor. */
+	const char *kernel;	/* Generation kernel, or NULL. */
+	const char *engine;	/* "clusters" or "hashlife", or NULL. */
+	int	 hashstep;	/* log2 generations per hashlife update. */
+	int	 hashwarmup;	/* log2 generations to skip at startup. */
+	int	 nofill;	/* Never add patterns on our own. */
+};
+
+/*
+ * Counters kept by the simulation, for reporting performance.  They only
+ * ever go up; callers look at how much they went up by.
+ */
+struct life_counters {
+	uint64_t generations;
+	uint64_t births;
+	uint64_t deaths;
+	uint64_t updated;	/* Clusters updated, summed over generations. */
+	uint64_t clusters;	/* Clusters in all, likewise. */
+	uint64_t created;	/* Clusters created. */
+	uint64_t deleted;	/* Clusters deleted. */
+	uint64_t woken;		/* Idle clusters made active again. */
+	uint64_t patterns;	/* Patterns added. */
+	int64_t	 patterntime;	/* Microseconds spent adding patterns. */
+};
+
+struct life_state {
+	struct cell_cluster **clustertable;	/* Hash table of clusters. */
+	unsigned int clustermask;	/* Number of table slots - 1. */
+	struct cluster_pool clusterpool;
+	TAILQ_HEAD(cell_cluster_list, cell_cluster) active;
+	struct cell_cluster_list idle;
+#ifdef HAVE_PTHREAD
+	struct cell_cluster **worklist;	/* Snapshot of the active list. */
+	int	 worklistsize;
+#endif
+
+	int	 numclusters;	/* Number of clusters allocated. */
+	int	 numcells;	/* Number of cells in those clusters. */
+	int	 maxclusters;	/* Clusters in the view. */
+	int	 maxcells;	/* Cells in the view. */
+	int	 cluster_numX;	/* Size of the view in clusters. */
+	int	 cluster_numY;
+	int	 universe_numX;	/* Size of the universe in clusters, */
+	int	 universe_numY;	/* or 0 if unbounded. */
+	int	 view_clusterX;	/* Cluster at the top left of the view. */
+	int	 view_clusterY;
+	int	 numvisible;	/* Clusters within the view. */
+	uint64_t *viewmap;	/* Which of them exist. */
+	int	 viewmapwords;	/* Words per row of viewmap. */
+	int	 cell_numX;	/* Size of the view in cells. */
+	int	 cell_numY;
+	int	 numcolors;
+	int	 colorwrap;	/* Colors wrap around to 0 here. */
+	int	 cellmaxage;	/* Cells die when they reach this age. */
+	int	 gensperdraw;	/* Most generations between frames drawn. */
+	int	 limitdraw;	/* LIMIT_DRAW and LIMIT_UPDATE, stretched */
+	int	 limitupdate;	/* by gensperdraw. */
+	int	 numactive;	/* Clusters updated last generation. */
+	unsigned int iteration;
+	int	 parity;	/* Buffer holding the current generation. */
+	int	 nofill;	/* Never add patterns on our own. */
+
+	int	 numthreads;
+#ifdef HAVE_PTHREAD
+	struct life_threadpool *pool;
+#endif
+
+	/*
+	 * Hashlife engine, if selected instead of clusters.  The engine only
+	 * knows which cells are alive; the colors of the cells in the view
+	 * are kept here.  See life_hashlife_update().
+	 */
+	struct hashlife *hashlife;
+	int	 hashstep;	/* log2 generations per update. */
+	int	 hashwarmup;	/* log2 generations to skip at startup. */
+	int	 hashcrop;	/* log2 size of the universe to keep. */
+	cell	*hashcells;	/* Cell colors, cell_numX by cell_numY. */
+	cell	*hashnext;	/* Scratch buffer for the next colors. */
+	cell	*hashdrawn;	/* Cell colors as last drawn. */
+
+	/* Generation kernel; see life_cluster_update_*(). */
+	int	(*cluster_update)(struct life_state *st,
+				  struct cell_cluster *cluster,
+				  unsigned int *randstate);
+
+	/*
+	 * Pattern data.  Patterns from packs point into the packs, which stay
+	 * mapped until life_pattern_free().  While patterns are loaded in the
+	 * background, only the builtin patterns are here.
+	 */
+	struct pattern patterns[NUMPATTERNS];
+	struct pattern_pack *packs;
+#ifdef HAVE_PTHREAD
+	struct pattern_loader *loader;	/* Until the patterns are loaded. */
+#endif
+
+	struct life_counters counters;
+};
+
+
+void		 life_state_init(struct life_state *st,
+				 const struct life_params *params);
+void		 life_state_free(struct life_state *st);
+void		 life_state_update(struct life_state *st);
+void		 life_state_pan(struct life_state *st,
+				int xoffset, int yoffset);
+void		 life_state_resize(struct life_state *st,
+				   int cell_numX, int cell_numY);
+struct cell_cluster *life_cluster_lookup(const struct life_state * const st,
+					 int clusterX, int clusterY);
+void		 life_cell_set(struct life_state *st, int x, int y, int color);
+int		 life_state_save(const struct life_state * const st,
+				 const char *filename);
+int		 life_state_restore(struct life_state *st,
+				    const char *filename);
+void		 life_pattern_init(struct life_state *st,
+				   const char *pattern_path, int background);
+void		 life_pattern_free(struct life_state *st);
+int64_t		 life_time(void);
+int		 life_pattern_read(const struct life_state * const st,
+				   const char *filename,
+				   struct pattern *pattern);
+struct pattern_pack *life_pack_open(const char *filename);
+int		 life_pack_pattern(const struct life_state * const st,
+				   const struct pattern_pack *pack,
+				   unsigned int idx, struct pattern *pattern);
+void		 life_pack_close(struct pattern_pack *pack);
+void		 life_pattern_orient(const struct pattern *pattern,
+				     int orientation, const struct coords *coord,
+				     struct coords *oriented);
+void		 life_pattern_stamp(struct pattern *pattern);
+void		 life_stamp_free(struct pattern_stamp *stamp);
+
+
+/*
+ * life_cluster_wrap() - Wrap cluster coordinates around a bounded universe.
+ */
+static __inline
+void
+life_cluster_wrap(const struct life_state * const st,
+		  int *clusterX, int *clusterY)
+{
+
+	if (st->universe_numX == 0)
+		return;		/* Unbounded. */
+
+	*clusterX %= st->universe_numX;
+	if (*clusterX < 0)
+		*clusterX += st->universe_numX;
+	*clusterY %= st->universe_numY;
+	if (*clusterY < 0)
+		*clusterY += st->universe_numY;
+}
+
+
+/*
+ * life_cluster_visible() - Check whether a cluster is in the view.
+ *
+ *	Also returns the cluster's position relative to the top left cluster
+ *	in the view.
+ */
+static __inline
+int
+life_cluster_visible(const struct life_state * const st,
+		     int clusterX, int clusterY, int *viewX, int *viewY)
+{
+	int x, y;
+
+	x = clusterX - st->view_clusterX;
+	y = clusterY - st->view_clusterY;
+	if (st->universe_numX != 0) {
+		if (x < 0)
+			x += st->universe_numX;
+		if (y < 0)
+			y += st->universe_numY;
+	}
+	*viewX = x;
+	*viewY = y;
+	return (x >= 0 && x < st->cluster_numX &&
+		y >= 0 && y < st->cluster_numY);
+}
+
+#endif /* !CLIFE_SIM_H */